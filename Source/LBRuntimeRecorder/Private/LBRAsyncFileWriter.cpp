@@ -0,0 +1,422 @@
+#include "LBRAsyncFileWriter.h"
+#include "HAL/PlatformFileManager.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/RunnableThread.h"
+
+#if PLATFORM_LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+DEFINE_LOG_CATEGORY(LogLBRAsyncFileWriter);
+
+// AVIO 自身的小缓冲，攒满后才回调 WritePacket
+static constexpr int32 AVIOBufferSize = 256 * 1024;
+
+FLBRFileWriteStats FLBRFileWriteCounters::Snapshot() const
+{
+	FLBRFileWriteStats Stats;
+	Stats.BytesWritten = BytesWritten.GetValue();
+	Stats.BytesPending = BytesPending.GetValue();
+	Stats.PeakBytesPending = PeakBytesPending.GetValue();
+	Stats.Writes = Writes.GetValue();
+	Stats.AvgWriteMs = Stats.Writes > 0 ? FPlatformTime::ToMilliseconds64(WriteCycles.GetValue()) / Stats.Writes : 0.0;
+	Stats.MaxWriteMs = FPlatformTime::ToMilliseconds64(MaxWriteCycles.GetValue());
+	Stats.ProducerStalls = ProducerStalls.GetValue();
+	Stats.Errors = Errors.GetValue();
+	return Stats;
+}
+
+FLBRAsyncFileWriter::FLBRAsyncFileWriter(const FLBRFileWriteCountersPtr& InCounters, int32 InBufferMegabytes, bool bInDirectIO)
+	: Counters(InCounters.IsValid() ? InCounters : MakeShared<FLBRFileWriteCounters, ESPMode::ThreadSafe>())
+	, NumChunks(FMath::Max(2, InBufferMegabytes * 1024 * 1024 / ChunkSize))
+	, bDirectIO(bInDirectIO)
+{
+}
+
+FLBRAsyncFileWriter::~FLBRAsyncFileWriter()
+{
+	Close();
+}
+
+bool FLBRAsyncFileWriter::Open(const FString& InFilePath)
+{
+	check(!IOContext);
+	FilePath = InFilePath;
+
+	if (!OpenFile())
+	{
+		UE_LOG(LogLBRAsyncFileWriter, Error, TEXT("Failed to open %s"), *FilePath);
+		return false;
+	}
+
+	uint8* IOBuffer = static_cast<uint8*>(av_malloc(AVIOBufferSize));
+	IOContext = avio_alloc_context(IOBuffer, AVIOBufferSize, 1, this, nullptr, &FLBRAsyncFileWriter::WritePacket, &FLBRAsyncFileWriter::SeekPacket);
+	if (!IOContext)
+	{
+		av_free(IOBuffer);
+		CloseFile();
+		return false;
+	}
+
+	// 对齐分配，O_DIRECT 要求缓冲、偏移和长度都按扇区对齐
+	for (int32 i = 0; i < NumChunks; ++i)
+	{
+		uint8* Chunk = static_cast<uint8*>(FMemory::Malloc(ChunkSize, ChunkAlignment));
+		AllChunks.Add(Chunk);
+		FreeChunks.Enqueue(Chunk);
+	}
+
+	RequestEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	FreeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+
+	Writer = new FWriter(*this);
+	WriterThread = FRunnableThread::Create(Writer, TEXT("LBR_FileWriter"), 0, TPri_AboveNormal);
+	return true;
+}
+
+bool FLBRAsyncFileWriter::Close()
+{
+	if (!IOContext)
+	{
+		return !bFailed;
+	}
+
+	// AVIO 缓冲 -> 当前块 -> 写线程
+	avio_flush(IOContext);
+	SubmitChunk();
+
+	bClosing = true;
+	RequestEvent->Trigger();
+
+	if (WriterThread)
+	{
+		WriterThread->WaitForCompletion();
+		delete WriterThread;
+		WriterThread = nullptr;
+	}
+	delete Writer;
+	Writer = nullptr;
+
+	CloseFile();
+
+	// 缓冲可能被 AVIO 内部换过，释放当前指针
+	av_freep(&IOContext->buffer);
+	avio_context_free(&IOContext);
+
+	if (CurrentChunk)
+	{
+		FreeChunks.Enqueue(CurrentChunk);
+		CurrentChunk = nullptr;
+	}
+	FreeChunks.Empty();
+	for (uint8* Chunk : AllChunks)
+	{
+		FMemory::Free(Chunk);
+	}
+	AllChunks.Empty();
+
+	FPlatformProcess::ReturnSynchEventToPool(RequestEvent);
+	FPlatformProcess::ReturnSynchEventToPool(FreeEvent);
+	RequestEvent = nullptr;
+	FreeEvent = nullptr;
+
+	return !bFailed;
+}
+
+int FLBRAsyncFileWriter::WritePacket(void* Opaque, FLBRAVIOWriteBuffer Buffer, int BufferSize)
+{
+	FLBRAsyncFileWriter* Self = static_cast<FLBRAsyncFileWriter*>(Opaque);
+	if (Self->bFailed)
+	{
+		return AVERROR(EIO);
+	}
+
+	Self->Write(Buffer, BufferSize);
+	return BufferSize;
+}
+
+int64_t FLBRAsyncFileWriter::SeekPacket(void* Opaque, int64_t Offset, int Whence)
+{
+	FLBRAsyncFileWriter* Self = static_cast<FLBRAsyncFileWriter*>(Opaque);
+
+	// 文件长度即已追加的字节数
+	if (Whence & AVSEEK_SIZE)
+	{
+		return Self->AppendPos;
+	}
+
+	switch (Whence & ~AVSEEK_FORCE)
+	{
+	case SEEK_SET: Self->Position = Offset; break;
+	case SEEK_CUR: Self->Position += Offset; break;
+	case SEEK_END: Self->Position = Self->AppendPos + Offset; break;
+	default: return AVERROR(EINVAL);
+	}
+	return Self->Position;
+}
+
+void FLBRAsyncFileWriter::Write(const uint8* Data, int32 Size)
+{
+	int64 Pos = Position;
+	const int64 End = Pos + Size;
+
+	// ① 落在已交给写线程的区域：拷一份作为补丁按序提交，写线程执行时前面的块已经落盘
+	if (Pos < ChunkStart)
+	{
+		const int32 Num = int32(FMath::Min(End, ChunkStart) - Pos);
+		FRequest Request;
+		Request.Patch.Append(Data, Num);
+		Request.Offset = Pos;
+		Request.Size = Num;
+		Submit(MoveTemp(Request));
+		Data += Num;
+		Pos += Num;
+	}
+
+	// ② 落在当前块已填充的范围：直接改块内存
+	if (Pos < End && Pos < AppendPos)
+	{
+		const int32 Num = int32(FMath::Min(End, AppendPos) - Pos);
+		FMemory::Memcpy(CurrentChunk + (Pos - ChunkStart), Data, Num);
+		Data += Num;
+		Pos += Num;
+	}
+
+	// ③ 文件尾之后：越过尾部的空洞补零，然后追加
+	if (Pos < End)
+	{
+		if (Pos > AppendPos)
+		{
+			Append(nullptr, int32(Pos - AppendPos), true);
+		}
+		Append(Data, int32(End - Pos), false);
+	}
+
+	Position = End;
+}
+
+void FLBRAsyncFileWriter::Append(const uint8* Data, int32 Size, bool bZeroFill)
+{
+	while (Size > 0)
+	{
+		if (!CurrentChunk)
+		{
+			// 块全部在途说明磁盘跟不上，这里等待即把背压传回 mux 与编码阶段
+			bool bStalled = false;
+			while (!FreeChunks.Dequeue(CurrentChunk))
+			{
+				if (!bStalled)
+				{
+					Counters->ProducerStalls.Increment();
+					bStalled = true;
+				}
+				FreeEvent->Wait(10);
+			}
+			ChunkStart = AppendPos;
+		}
+
+		const int32 Fill = int32(AppendPos - ChunkStart);
+		const int32 Num = FMath::Min(Size, ChunkSize - Fill);
+		if (bZeroFill)
+		{
+			FMemory::Memzero(CurrentChunk + Fill, Num);
+		}
+		else
+		{
+			FMemory::Memcpy(CurrentChunk + Fill, Data, Num);
+			Data += Num;
+		}
+		AppendPos += Num;
+		Size -= Num;
+
+		if (Fill + Num == ChunkSize)
+		{
+			SubmitChunk();
+		}
+	}
+}
+
+void FLBRAsyncFileWriter::SubmitChunk()
+{
+	if (!CurrentChunk)
+	{
+		return;
+	}
+
+	const int32 Fill = int32(AppendPos - ChunkStart);
+	if (Fill > 0)
+	{
+		FRequest Request;
+		Request.Chunk = CurrentChunk;
+		Request.Offset = ChunkStart;
+		Request.Size = Fill;
+		Submit(MoveTemp(Request));
+	}
+	else
+	{
+		FreeChunks.Enqueue(CurrentChunk);
+	}
+
+	CurrentChunk = nullptr;
+	ChunkStart = AppendPos;
+}
+
+void FLBRAsyncFileWriter::Submit(FRequest&& Request)
+{
+	const int64 Pending = Counters->BytesPending.Add(Request.Size) + Request.Size;
+	if (Pending > Counters->PeakBytesPending.GetValue())
+	{
+		Counters->PeakBytesPending.Set(Pending);
+	}
+
+	Requests.Enqueue(MoveTemp(Request));
+	RequestEvent->Trigger();
+}
+
+uint32 FLBRAsyncFileWriter::FWriter::Run()
+{
+	Owner.RunWriter();
+	return 0;
+}
+
+void FLBRAsyncFileWriter::RunWriter()
+{
+	while (true)
+	{
+		FRequest Request;
+		if (Requests.Dequeue(Request))
+		{
+			// 出错后仍然消费请求并归还块，生产者由 WritePacket 返回错误停下
+			if (!bFailed && !WriteRequest(Request))
+			{
+				bFailed = true;
+				Counters->Errors.Increment();
+			}
+			Counters->BytesPending.Subtract(Request.Size);
+
+			if (Request.Chunk)
+			{
+				FreeChunks.Enqueue(Request.Chunk);
+				FreeEvent->Trigger();
+			}
+			continue;
+		}
+
+		if (bClosing && Requests.IsEmpty())
+		{
+			break;
+		}
+		RequestEvent->Wait(100);
+	}
+}
+
+bool FLBRAsyncFileWriter::WriteRequest(const FRequest& Request)
+{
+	const uint8* Data = Request.Chunk ? Request.Chunk : Request.Patch.GetData();
+	// 只有写满的整块才满足 O_DIRECT 的对齐要求
+	const bool bAligned = Request.Chunk && Request.Size == ChunkSize;
+
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+	const bool bOk = WriteAt(Data, Request.Size, Request.Offset, bAligned);
+	const int64 Cycles = int64(FPlatformTime::Cycles64() - StartCycles);
+
+	Counters->Writes.Increment();
+	Counters->WriteCycles.Add(Cycles);
+	if (Cycles > Counters->MaxWriteCycles.GetValue())
+	{
+		Counters->MaxWriteCycles.Set(Cycles);
+	}
+
+	if (bOk)
+	{
+		Counters->BytesWritten.Add(Request.Size);
+	}
+	else
+	{
+		UE_LOG(LogLBRAsyncFileWriter, Error, TEXT("Write of %d bytes at %lld failed: %s"), Request.Size, Request.Offset, *FilePath);
+	}
+	return bOk;
+}
+
+#if PLATFORM_LINUX
+
+bool FLBRAsyncFileWriter::OpenFile()
+{
+	const FTCHARToUTF8 Path(*FilePath);
+	Fd = ::open(Path.Get(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (Fd < 0)
+	{
+		return false;
+	}
+	posix_fadvise(Fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	if (bDirectIO)
+	{
+#ifdef O_DIRECT
+		DirectFd = ::open(Path.Get(), O_WRONLY | O_DIRECT | O_CLOEXEC);
+#endif
+		if (DirectFd < 0)
+		{
+			UE_LOG(LogLBRAsyncFileWriter, Warning, TEXT("O_DIRECT not available for %s, using buffered writes"), *FilePath);
+		}
+	}
+	return true;
+}
+
+void FLBRAsyncFileWriter::CloseFile()
+{
+	if (DirectFd >= 0)
+	{
+		::close(DirectFd);
+		DirectFd = -1;
+	}
+	if (Fd >= 0)
+	{
+		::close(Fd);
+		Fd = -1;
+	}
+}
+
+bool FLBRAsyncFileWriter::WriteAt(const uint8* Data, int32 Size, int64 Offset, bool bAligned)
+{
+	const int TargetFd = bAligned && DirectFd >= 0 ? DirectFd : Fd;
+	while (Size > 0)
+	{
+		const ssize_t Written = ::pwrite(TargetFd, Data, Size, Offset);
+		if (Written < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+		Data += Written;
+		Size -= int32(Written);
+		Offset += Written;
+	}
+	return true;
+}
+
+#else
+
+bool FLBRAsyncFileWriter::OpenFile()
+{
+	Handle = FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*FilePath);
+	return Handle != nullptr;
+}
+
+void FLBRAsyncFileWriter::CloseFile()
+{
+	delete Handle;
+	Handle = nullptr;
+}
+
+bool FLBRAsyncFileWriter::WriteAt(const uint8* Data, int32 Size, int64 Offset, bool bAligned)
+{
+	return Handle->Seek(Offset) && Handle->Write(Data, Size);
+}
+
+#endif
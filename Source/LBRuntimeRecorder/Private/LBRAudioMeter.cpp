@@ -0,0 +1,183 @@
+#include "LBRAudioMeter.h"
+#include "LBRFFmpegEncodeThread.h"
+#include "LBRSimd.h"
+
+namespace
+{
+	FORCEINLINE int32 FloatToBits(float Value)
+	{
+		int32 Bits;
+		FMemory::Memcpy(&Bits, &Value, sizeof(Bits));
+		return Bits;
+	}
+
+	FORCEINLINE float BitsToFloat(int32 Bits)
+	{
+		float Value;
+		FMemory::Memcpy(&Value, &Bits, sizeof(Value));
+		return Value;
+	}
+
+	FORCEINLINE float ToDecibels(float Linear)
+	{
+		return Linear > 1e-5f ? 20.f * FMath::LogX(10.f, Linear) : -100.f;
+	}
+
+	// 每声道峰值（绝对值）与平方和，结果累加进 Peak / SumSquares
+	// 声道数整除 8 时，每 8 个样本中第 j 个总属于声道 j % NumChannels，可以整段向量化
+	void Measure(const float* Data, int32 NumSamples, int32 NumChannels, float* Peak, double* SumSquares)
+	{
+		int32 Index = 0;
+
+#if LBR_SIMD_SSE || LBR_SIMD_NEON
+		if (8 % NumChannels == 0)
+		{
+			alignas(16) float LanePeak[8];
+			alignas(16) float LaneSquares[8];
+
+#if LBR_SIMD_SSE
+			const __m128 AbsMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+			__m128 Peak0 = _mm_setzero_ps();
+			__m128 Peak1 = _mm_setzero_ps();
+			__m128 Sq0 = _mm_setzero_ps();
+			__m128 Sq1 = _mm_setzero_ps();
+
+			for (; Index + 8 <= NumSamples; Index += 8)
+			{
+				const __m128 A = _mm_loadu_ps(Data + Index);
+				const __m128 B = _mm_loadu_ps(Data + Index + 4);
+				Peak0 = _mm_max_ps(Peak0, _mm_and_ps(A, AbsMask));
+				Peak1 = _mm_max_ps(Peak1, _mm_and_ps(B, AbsMask));
+				Sq0 = _mm_add_ps(Sq0, _mm_mul_ps(A, A));
+				Sq1 = _mm_add_ps(Sq1, _mm_mul_ps(B, B));
+			}
+
+			_mm_store_ps(LanePeak, Peak0);
+			_mm_store_ps(LanePeak + 4, Peak1);
+			_mm_store_ps(LaneSquares, Sq0);
+			_mm_store_ps(LaneSquares + 4, Sq1);
+#else
+			float32x4_t Peak0 = vdupq_n_f32(0.f);
+			float32x4_t Peak1 = vdupq_n_f32(0.f);
+			float32x4_t Sq0 = vdupq_n_f32(0.f);
+			float32x4_t Sq1 = vdupq_n_f32(0.f);
+
+			for (; Index + 8 <= NumSamples; Index += 8)
+			{
+				const float32x4_t A = vld1q_f32(Data + Index);
+				const float32x4_t B = vld1q_f32(Data + Index + 4);
+				Peak0 = vmaxq_f32(Peak0, vabsq_f32(A));
+				Peak1 = vmaxq_f32(Peak1, vabsq_f32(B));
+				Sq0 = vmlaq_f32(Sq0, A, A);
+				Sq1 = vmlaq_f32(Sq1, B, B);
+			}
+
+			vst1q_f32(LanePeak, Peak0);
+			vst1q_f32(LanePeak + 4, Peak1);
+			vst1q_f32(LaneSquares, Sq0);
+			vst1q_f32(LaneSquares + 4, Sq1);
+#endif
+
+			for (int32 Lane = 0; Lane < 8; ++Lane)
+			{
+				const int32 Channel = Lane % NumChannels;
+				Peak[Channel] = FMath::Max(Peak[Channel], LanePeak[Lane]);
+				SumSquares[Channel] += LaneSquares[Lane];
+			}
+		}
+#endif
+
+		// 标量尾部（或声道数不整除 8 时全部走这里）；Index 是声道数的整数倍
+		for (; Index < NumSamples; ++Index)
+		{
+			const int32 Channel = Index % NumChannels;
+			const float Sample = Data[Index];
+			Peak[Channel] = FMath::Max(Peak[Channel], FMath::Abs(Sample));
+			SumSquares[Channel] += double(Sample) * Sample;
+		}
+	}
+}
+
+void FLBRAudioMeter::Process(const float* Interleaved, int32 NumFrames, int32 InNumChannels)
+{
+	if (!Interleaved || NumFrames <= 0 || InNumChannels <= 0)
+	{
+		return;
+	}
+
+	float BlockPeak[MaxChannels] = {};
+	double BlockSumSquares[MaxChannels] = {};
+
+	if (InNumChannels <= MaxChannels)
+	{
+		Measure(Interleaved, NumFrames * InNumChannels, InNumChannels, BlockPeak, BlockSumSquares);
+	}
+	else
+	{
+		// 声道过多时逐帧只统计前 MaxChannels 个
+		for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+		{
+			Measure(Interleaved + Frame * InNumChannels, MaxChannels, MaxChannels, BlockPeak, BlockSumSquares);
+		}
+	}
+
+	const int32 MeteredChannels = FMath::Min(InNumChannels, MaxChannels);
+	bool bClipped = false;
+	for (int32 Channel = 0; Channel < MeteredChannels; ++Channel)
+	{
+		const float RMS = float(FMath::Sqrt(BlockSumSquares[Channel] / NumFrames));
+		PeakBits[Channel].Set(FloatToBits(BlockPeak[Channel]));
+		RMSBits[Channel].Set(FloatToBits(RMS));
+
+		IntervalPeak[Channel] = FMath::Max(IntervalPeak[Channel], BlockPeak[Channel]);
+		IntervalSumSquares[Channel] += BlockSumSquares[Channel];
+		bClipped |= BlockPeak[Channel] >= 1.f;
+	}
+	IntervalFrames += NumFrames;
+	NumChannels.Set(MeteredChannels);
+
+	if (bClipped)
+	{
+		ClippedBlocks.Increment();
+	}
+}
+
+void FLBRAudioMeter::LogSummaryIfDue(double Now, double IntervalSeconds)
+{
+	if (LastLogTime == 0.0)
+	{
+		LastLogTime = Now;
+		return;
+	}
+
+	if (Now - LastLogTime < IntervalSeconds || IntervalFrames == 0)
+	{
+		return;
+	}
+
+	FString Levels;
+	for (int32 Channel = 0; Channel < GetNumChannels(); ++Channel)
+	{
+		const float RMS = float(FMath::Sqrt(IntervalSumSquares[Channel] / IntervalFrames));
+		Levels += FString::Printf(TEXT(" [%d] peak %.1fdB rms %.1fdB"), Channel, ToDecibels(IntervalPeak[Channel]), ToDecibels(RMS));
+
+		IntervalPeak[Channel] = 0.f;
+		IntervalSumSquares[Channel] = 0.0;
+	}
+
+	UE_LOG(LogFFmpegEncodeThread, Log, TEXT("Audio levels (%.1fs):%s clipped blocks=%lld"),
+		Now - LastLogTime, *Levels, ClippedBlocks.GetValue());
+
+	IntervalFrames = 0;
+	LastLogTime = Now;
+}
+
+float FLBRAudioMeter::GetPeak(int32 Channel) const
+{
+	return Channel >= 0 && Channel < MaxChannels ? BitsToFloat(PeakBits[Channel].GetValue()) : 0.f;
+}
+
+float FLBRAudioMeter::GetRMS(int32 Channel) const
+{
+	return Channel >= 0 && Channel < MaxChannels ? BitsToFloat(RMSBits[Channel].GetValue()) : 0.f;
+}
@@ -0,0 +1,219 @@
+#include "LBRClipExtractor.h"
+#include "Async/Async.h"
+#include "LBRFFmpegEncodeThread.h"
+#include "LBRKeyframeIndex.h"
+
+namespace
+{
+	// 把输入定位到 StartSec 之前最近的关键帧附近
+	bool SeekToClipStart(AVFormatContext* In, const FString& SourceFile, double StartSec)
+	{
+		const int64 FileStart = In->start_time != AV_NOPTS_VALUE ? In->start_time : 0;
+		int64 TargetUs = int64(StartSec * AV_TIME_BASE);
+
+		FLBRKeyframeIndex Index;
+		if (Index.Load(SourceFile))
+		{
+			if (const FLBRKeyframeIndexEntry* Keyframe = Index.FindAtOrBefore(TargetUs))
+			{
+				// TS 没有自带索引，按时间定位要在文件里二分查找；索引里的偏移是关键帧位置的下界，直接跳过去
+				if (FCStringAnsi::Strstr(In->iformat->name, "mpegts") && Keyframe->ByteOffset >= 0
+					&& av_seek_frame(In, -1, Keyframe->ByteOffset, AVSEEK_FLAG_BYTE) >= 0)
+				{
+					return true;
+				}
+				TargetUs = Keyframe->TimeUs;
+			}
+		}
+
+		if (TargetUs <= 0)
+		{
+			return true;
+		}
+
+		// 最大允许时间即目标本身，demuxer 会落在不晚于它的关键帧上
+		const int64 Target = FileStart + TargetUs;
+		return avformat_seek_file(In, -1, INT64_MIN, Target, Target, 0) >= 0;
+	}
+}
+
+bool FLBRClipExtractor::ExtractClip(const FString& SourceFile, double StartSec, double EndSec, const FString& OutFile)
+{
+	if (EndSec <= StartSec)
+	{
+		UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Clip: invalid range %.3f - %.3f"), StartSec, EndSec);
+		return false;
+	}
+
+	AVFormatContext* In = nullptr;
+	if (avformat_open_input(&In, TCHAR_TO_UTF8(*SourceFile), nullptr, nullptr) < 0)
+	{
+		UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Clip: failed to open %s"), *SourceFile);
+		return false;
+	}
+
+	if (avformat_find_stream_info(In, nullptr) < 0)
+	{
+		UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Clip: failed to read stream info from %s"), *SourceFile);
+		avformat_close_input(&In);
+		return false;
+	}
+
+	AVFormatContext* Out = nullptr;
+	avformat_alloc_output_context2(&Out, nullptr, nullptr, TCHAR_TO_UTF8(*OutFile));
+	if (!Out)
+	{
+		UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Clip: failed to create format context for %s"), *OutFile);
+		avformat_close_input(&In);
+		return false;
+	}
+
+	// 输入流序号 -> 输出流序号，只拷贝音视频
+	TArray<int32> StreamMap;
+	StreamMap.Init(INDEX_NONE, In->nb_streams);
+	int32 VideoStream = INDEX_NONE;
+	for (uint32 i = 0; i < In->nb_streams; ++i)
+	{
+		const AVCodecParameters* Params = In->streams[i]->codecpar;
+		if (Params->codec_type != AVMEDIA_TYPE_VIDEO && Params->codec_type != AVMEDIA_TYPE_AUDIO)
+		{
+			continue;
+		}
+		if (Params->codec_type == AVMEDIA_TYPE_VIDEO && VideoStream == INDEX_NONE)
+		{
+			VideoStream = int32(i);
+		}
+
+		AVStream* Stream = avformat_new_stream(Out, nullptr);
+		avcodec_parameters_copy(Stream->codecpar, Params);
+		// 不同容器的 tag 不通用，交给 muxer 重新选
+		Stream->codecpar->codec_tag = 0;
+		Stream->time_base = In->streams[i]->time_base;
+		StreamMap[i] = Stream->index;
+	}
+
+	bool bSuccess = false;
+	int64 Written = 0;
+	if (VideoStream == INDEX_NONE)
+	{
+		UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Clip: %s has no video stream"), *SourceFile);
+	}
+	else if (!SeekToClipStart(In, SourceFile, StartSec))
+	{
+		UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Clip: failed to seek %s to %.3fs"), *SourceFile, StartSec);
+	}
+	else if (!(Out->oformat->flags & AVFMT_NOFILE) && avio_open(&Out->pb, TCHAR_TO_UTF8(*OutFile), AVIO_FLAG_WRITE) < 0)
+	{
+		UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Clip: failed to open %s"), *OutFile);
+	}
+	else
+	{
+		int Ret = avformat_write_header(Out, nullptr);
+		if (Ret < 0)
+		{
+			UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Clip: avformat_write_header failed: %d"), Ret);
+		}
+		else
+		{
+			const double FileStart = In->start_time != AV_NOPTS_VALUE ? double(In->start_time) / AV_TIME_BASE : 0.0;
+			const double EndTime = FileStart + EndSec;
+
+			// 片段零点：定位后遇到的第一个视频关键帧
+			double ClipStart = 0.0;
+			bool bStarted = false;
+
+			TArray<bool> StreamEnded;
+			StreamEnded.Init(false, In->nb_streams);
+			int32 NumActive = Out->nb_streams;
+
+			AVPacket* Pkt = av_packet_alloc();
+			while (NumActive > 0 && (Ret = av_read_frame(In, Pkt)) >= 0)
+			{
+				const int32 InIndex = Pkt->stream_index;
+				const AVRational TimeBase = In->streams[InIndex]->time_base;
+				const int64 Timestamp = Pkt->pts != AV_NOPTS_VALUE ? Pkt->pts : Pkt->dts;
+
+				bool bWrite = StreamMap[InIndex] != INDEX_NONE && !StreamEnded[InIndex] && Timestamp != AV_NOPTS_VALUE;
+				if (bWrite)
+				{
+					const double Time = Timestamp * av_q2d(TimeBase);
+					if (!bStarted)
+					{
+						bStarted = InIndex == VideoStream && (Pkt->flags & AV_PKT_FLAG_KEY);
+						ClipStart = Time;
+					}
+
+					// 起点之后的视频包都要保留以便解码，只裁掉关键帧之前的音频
+					if (!bStarted || (InIndex != VideoStream && Time < ClipStart))
+					{
+						bWrite = false;
+					}
+					else if (Time >= EndTime)
+					{
+						// 视频按 dts 判断，避免 B 帧的 pts 提前结束
+						const double DecodeTime = Pkt->dts != AV_NOPTS_VALUE ? Pkt->dts * av_q2d(TimeBase) : Time;
+						if (InIndex != VideoStream || DecodeTime >= EndTime)
+						{
+							StreamEnded[InIndex] = true;
+							--NumActive;
+							bWrite = false;
+						}
+					}
+				}
+
+				if (bWrite)
+				{
+					const int64 Offset = av_rescale_q(int64(ClipStart * AV_TIME_BASE), AV_TIME_BASE_Q, TimeBase);
+					if (Pkt->pts != AV_NOPTS_VALUE)
+					{
+						Pkt->pts -= Offset;
+					}
+					if (Pkt->dts != AV_NOPTS_VALUE)
+					{
+						Pkt->dts -= Offset;
+					}
+					Pkt->stream_index = StreamMap[InIndex];
+					Pkt->pos = -1;
+					av_packet_rescale_ts(Pkt, TimeBase, Out->streams[Pkt->stream_index]->time_base);
+
+					Ret = av_interleaved_write_frame(Out, Pkt);
+					if (Ret < 0)
+					{
+						UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Clip: av_interleaved_write_frame failed: %d"), Ret);
+						break;
+					}
+					++Written;
+				}
+				av_packet_unref(Pkt);
+			}
+			av_packet_free(&Pkt);
+
+			// 读到文件尾也算正常结束
+			bSuccess = (Ret >= 0 || Ret == AVERROR_EOF) && Written > 0 && av_write_trailer(Out) >= 0;
+		}
+
+		if (!(Out->oformat->flags & AVFMT_NOFILE))
+		{
+			avio_closep(&Out->pb);
+		}
+	}
+
+	avformat_free_context(Out);
+	avformat_close_input(&In);
+
+	UE_LOG(LogFFmpegEncodeThread, Log, TEXT("Clip %.3f - %.3fs of %s -> %s (%lld packets): %s"),
+		StartSec, EndSec, *SourceFile, *OutFile, Written, bSuccess ? TEXT("OK") : TEXT("FAILED"));
+	return bSuccess;
+}
+
+void FLBRClipExtractor::ExtractClipAsync(const FString& SourceFile, double StartSec, double EndSec, const FString& OutFile, FOnClipExtracted&& OnExtracted)
+{
+	Async(EAsyncExecution::ThreadPool, [SourceFile, StartSec, EndSec, OutFile, OnExtracted = MoveTemp(OnExtracted)]()
+		{
+			const bool bSuccess = ExtractClip(SourceFile, StartSec, EndSec, OutFile);
+			if (OnExtracted)
+			{
+				OnExtracted(OutFile, bSuccess);
+			}
+		});
+}
@@ -0,0 +1,121 @@
+#include "LBRColorCorrection.h"
+#include "LBRSimd.h"
+#include "Async/ParallelFor.h"
+
+namespace
+{
+	// 每个并行任务处理的行数
+	constexpr int32 RowsPerBand = 32;
+
+	void ApplyLUTScalar(const uint8* Table, FColor* Pixels, int64 NumPixels)
+	{
+		for (int64 i = 0; i < NumPixels; ++i)
+		{
+			FColor& Pixel = Pixels[i];
+			Pixel.B = Table[Pixel.B];
+			Pixel.G = Table[Pixel.G];
+			Pixel.R = Table[Pixel.R];
+		}
+	}
+
+#if LBR_SIMD_NEON
+	// tbl 查 0~63，后三段用 tbx 在越界时保留上一步结果
+	int64 ApplyLUTVector(const uint8* Table, FColor* Pixels, int64 NumPixels)
+	{
+		uint8x16x4_t Quarters[4];
+		for (int32 q = 0; q < 4; ++q)
+		{
+			for (int32 v = 0; v < 4; ++v)
+			{
+				Quarters[q].val[v] = vld1q_u8(Table + q * 64 + v * 16);
+			}
+		}
+
+		const uint8x16_t AlphaMask = vreinterpretq_u8_u32(vdupq_n_u32(0xFF000000u));
+		const uint8x16_t Offset64 = vdupq_n_u8(64);
+		const uint8x16_t Offset128 = vdupq_n_u8(128);
+		const uint8x16_t Offset192 = vdupq_n_u8(192);
+
+		uint8* Data = reinterpret_cast<uint8*>(Pixels);
+		const int64 NumVectorPixels = NumPixels & ~int64(3);
+		for (int64 i = 0; i < NumVectorPixels; i += 4)
+		{
+			uint8* Ptr = Data + i * 4;
+			const uint8x16_t X = vld1q_u8(Ptr);
+
+			uint8x16_t Result = vqtbl4q_u8(Quarters[0], X);
+			Result = vqtbx4q_u8(Result, Quarters[1], vsubq_u8(X, Offset64));
+			Result = vqtbx4q_u8(Result, Quarters[2], vsubq_u8(X, Offset128));
+			Result = vqtbx4q_u8(Result, Quarters[3], vsubq_u8(X, Offset192));
+
+			vst1q_u8(Ptr, vbslq_u8(AlphaMask, X, Result));
+		}
+		return NumVectorPixels;
+	}
+#endif
+}
+
+FLBRToneLUT::FLBRToneLUT()
+{
+	for (int32 i = 0; i < 256; ++i)
+	{
+		Table[i] = uint8(i);
+	}
+}
+
+void FLBRToneLUT::Build(float InGamma, float InExposure)
+{
+	Gamma = InGamma;
+	Exposure = InExposure;
+
+	// 与原逐像素实现的计算顺序保持一致，查表结果逐位相同
+	const float InvGamma = 1.0f / InGamma;
+
+	bIdentity = true;
+	for (int32 i = 0; i < 256; ++i)
+	{
+		float C = i / 255.0f;
+		C = FMath::Clamp(C * InExposure, 0.0f, 1.0f);
+		C = FMath::Pow(C, InvGamma);
+
+		Table[i] = uint8(FMath::Clamp(FMath::RoundToInt(C * 255), 0, 255));
+		bIdentity &= (Table[i] == i);
+	}
+}
+
+bool FLBRToneLUT::Matches(float InGamma, float InExposure) const
+{
+	return Gamma == InGamma && Exposure == InExposure;
+}
+
+void FLBRToneLUT::Apply(FColor* Pixels, int32 NumPixels) const
+{
+	if (bIdentity || !Pixels || NumPixels <= 0)
+	{
+		return;
+	}
+
+#if LBR_SIMD_NEON
+	const int64 Done = ApplyLUTVector(Table, Pixels, NumPixels);
+	ApplyLUTScalar(Table, Pixels + Done, NumPixels - Done);
+#else
+	// x86 没有 256 项字节查表指令，用 shuffle 拼出来要 16 遍比较，不如标量查表快
+	ApplyLUTScalar(Table, Pixels, NumPixels);
+#endif
+}
+
+void FLBRToneLUT::ApplyParallel(FColor* Pixels, int32 Width, int32 Height) const
+{
+	if (bIdentity || !Pixels || Width <= 0 || Height <= 0)
+	{
+		return;
+	}
+
+	const int32 NumBands = FMath::DivideAndRoundUp(Height, RowsPerBand);
+	ParallelFor(NumBands, [this, Pixels, Width, Height](int32 Band)
+		{
+			const int32 StartRow = Band * RowsPerBand;
+			const int32 NumRows = FMath::Min(RowsPerBand, Height - StartRow);
+			Apply(Pixels + int64(StartRow) * Width, NumRows * Width);
+		});
+}
@@ -0,0 +1,307 @@
+#include "LBREncodeScheduler.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/ScopeLock.h"
+
+DEFINE_LOG_CATEGORY(LogLBREncodeScheduler);
+
+// 音频和 mux 很轻，时间片按项数给宽一些，减少领取次数
+static constexpr int32 AudioBlocksPerSlice = 8;
+static constexpr int32 MuxPacketsPerSlice = 64;
+
+// 没有事件可等的工作（音频环）靠轮询发现，与独立线程模式的音频阶段一致
+static constexpr uint32 IdleWaitMs = 10;
+
+static EThreadPriority ToThreadPriority(ELBREncodeThreadPriority Priority)
+{
+	switch (Priority)
+	{
+	case ELBREncodeThreadPriority::Lowest:
+		return TPri_Lowest;
+
+	case ELBREncodeThreadPriority::Normal:
+		return TPri_Normal;
+
+	case ELBREncodeThreadPriority::AboveNormal:
+		return TPri_AboveNormal;
+
+	case ELBREncodeThreadPriority::BelowNormal:
+	default:
+		return TPri_BelowNormal;
+	}
+}
+
+FLBREncodeScheduler::FLBREncodeScheduler(const FLBREncodeSchedulerSettings& InSettings)
+	: Settings(InSettings)
+{
+	WorkEvent = FPlatformProcess::GetSynchEventFromPool(false);
+
+	const int32 NumWorkers = Settings.NumWorkers > 0 ? Settings.NumWorkers : FMath::Max(1, FPlatformMisc::NumberOfCores() / 2);
+	const uint64 Affinity = Settings.AffinityMask != 0 ? uint64(Settings.AffinityMask) : FPlatformAffinity::GetNoAffinityMask();
+	for (int32 i = 0; i < NumWorkers; ++i)
+	{
+		FWorker* Worker = new FWorker(*this);
+		Workers.Add(Worker);
+		Threads.Add(FRunnableThread::Create(
+			Worker,
+			*FString::Printf(TEXT("LBR_EncodeWorker_%d"), i),
+			0,
+			ToThreadPriority(Settings.Priority),
+			Affinity
+		));
+	}
+
+	UE_LOG(LogLBREncodeScheduler, Log, TEXT("Encode scheduler: %d workers, affinity 0x%llx, %d codec threads per session"),
+		NumWorkers, Affinity, Settings.CodecThreadsPerSession);
+}
+
+FLBREncodeScheduler::~FLBREncodeScheduler()
+{
+	Shutdown();
+
+	if (WorkEvent)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(WorkEvent);
+		WorkEvent = nullptr;
+	}
+}
+
+void FLBREncodeScheduler::AddSession(const FEncoderPtr& Encoder)
+{
+	check(Encoder.IsValid());
+	Encoder->AttachScheduler(WorkEvent, Settings.CodecThreadsPerSession);
+
+	TSharedPtr<FSession> Session = MakeShared<FSession>();
+	Session->Encoder = Encoder;
+	Session->DoneEvent = FPlatformProcess::GetSynchEventFromPool(true);
+	{
+		FScopeLock Lock(&Mutex);
+		Sessions.Add(Session);
+	}
+	WorkEvent->Trigger();
+}
+
+void FLBREncodeScheduler::WaitForSession(const FLBRFFmpegEncodeThread* Encoder)
+{
+	TSharedPtr<FSession> Session;
+	{
+		FScopeLock Lock(&Mutex);
+		for (const TSharedPtr<FSession>& Candidate : Sessions)
+		{
+			if (Candidate->Encoder.Get() == Encoder)
+			{
+				Session = Candidate;
+				break;
+			}
+		}
+	}
+
+	if (!Session.IsValid())
+	{
+		return;
+	}
+
+	Session->DoneEvent->Wait();
+
+	{
+		FScopeLock Lock(&Mutex);
+		Sessions.Remove(Session);
+		NextSlot = 0;
+	}
+	FPlatformProcess::ReturnSynchEventToPool(Session->DoneEvent);
+	Session->DoneEvent = nullptr;
+}
+
+void FLBREncodeScheduler::Shutdown()
+{
+	if (Threads.Num() == 0)
+	{
+		return;
+	}
+
+	// 还在录制的会话按正常流程停止，文件照常写完
+	TArray<TSharedPtr<FSession>> Remaining;
+	{
+		FScopeLock Lock(&Mutex);
+		Remaining = Sessions;
+	}
+	for (const TSharedPtr<FSession>& Session : Remaining)
+	{
+		Session->Encoder->StopRecording();
+	}
+	for (const TSharedPtr<FSession>& Session : Remaining)
+	{
+		WaitForSession(Session->Encoder.Get());
+	}
+
+	bStopping = true;
+	WorkEvent->Trigger();
+
+	for (FRunnableThread* Thread : Threads)
+	{
+		Thread->WaitForCompletion();
+		delete Thread;
+	}
+	Threads.Empty();
+
+	for (FWorker* Worker : Workers)
+	{
+		delete Worker;
+	}
+	Workers.Empty();
+}
+
+int32 FLBREncodeScheduler::GetNumSessions() const
+{
+	FScopeLock Lock(&Mutex);
+	return Sessions.Num();
+}
+
+int32 FLBREncodeScheduler::GetNumSlots() const
+{
+	FScopeLock Lock(&Mutex);
+	return Sessions.Num() * NumStages;
+}
+
+bool FLBREncodeScheduler::ClaimWork(FClaim& OutClaim)
+{
+	FScopeLock Lock(&Mutex);
+
+	// 从上次领取的下一个位置开始，每个会话的每个阶段轮流一次，会话之间平分工作线程
+	const int32 NumSlots = Sessions.Num() * NumStages;
+	for (int32 i = 0; i < NumSlots; ++i)
+	{
+		const int32 Slot = (NextSlot + i) % NumSlots;
+		FSession& Session = *Sessions[Slot / NumStages];
+		const int32 Stage = Slot % NumStages;
+
+		if (Session.bDone || Session.bClaimed)
+		{
+			continue;
+		}
+
+		if (!Session.bInitialized)
+		{
+			// Init 期间各阶段都不能执行
+			if (Stage == 0)
+			{
+				Session.bClaimed = true;
+				OutClaim.Session = Sessions[Slot / NumStages];
+				OutClaim.Stage = INDEX_NONE;
+				NextSlot = Slot + 1;
+				return true;
+			}
+			continue;
+		}
+
+		if (Session.bStageBusy[Stage] || Session.bStageFinished[Stage])
+		{
+			continue;
+		}
+
+		Session.bStageBusy[Stage] = true;
+		OutClaim.Session = Sessions[Slot / NumStages];
+		OutClaim.Stage = Stage;
+		NextSlot = Slot + 1;
+		return true;
+	}
+	return false;
+}
+
+bool FLBREncodeScheduler::Execute(const FClaim& Claim)
+{
+	FSession& Session = *Claim.Session;
+	FLBRFFmpegEncodeThread& Encoder = *Session.Encoder;
+
+	if (Claim.Stage == INDEX_NONE)
+	{
+		const bool bInitOk = Encoder.Init();
+
+		FScopeLock Lock(&Mutex);
+		Session.bClaimed = false;
+		if (bInitOk)
+		{
+			Session.bInitialized = true;
+		}
+		else
+		{
+			UE_LOG(LogLBREncodeScheduler, Error, TEXT("Encode session failed to initialize"));
+			MarkDone(Session);
+		}
+		return true;
+	}
+
+	const FLBRFFmpegEncodeThread::EStage Stage = FLBRFFmpegEncodeThread::EStage(Claim.Stage);
+	const int32 MaxItems = Stage == FLBRFFmpegEncodeThread::EStage::Video ? FMath::Max(1, Settings.VideoFramesPerSlice)
+		: Stage == FLBRFFmpegEncodeThread::EStage::Audio ? AudioBlocksPerSlice
+		: MuxPacketsPerSlice;
+
+	int32 Processed = 0;
+	const bool bStageFinished = Encoder.StepStage(Stage, MaxItems, Processed);
+
+	// 时间片用完说明还有积压，叫醒另一个线程一起处理
+	if (Processed >= MaxItems)
+	{
+		WorkEvent->Trigger();
+	}
+
+	bool bFinishSession = false;
+	{
+		FScopeLock Lock(&Mutex);
+		Session.bStageBusy[Claim.Stage] = false;
+		Session.bStageFinished[Claim.Stage] = bStageFinished;
+
+		bFinishSession = true;
+		for (int32 i = 0; i < NumStages; ++i)
+		{
+			bFinishSession &= Session.bStageFinished[i];
+		}
+		if (bFinishSession)
+		{
+			Session.bClaimed = true;
+		}
+	}
+
+	if (bFinishSession)
+	{
+		// 写 trailer、等待后台收尾的分段，在本工作线程上完成
+		Encoder.FinishEncode();
+
+		FScopeLock Lock(&Mutex);
+		MarkDone(Session);
+	}
+
+	// 阶段结束也算有进展，别的阶段可能因此可以继续
+	return Processed > 0 || bStageFinished;
+}
+
+void FLBREncodeScheduler::MarkDone(FSession& Session)
+{
+	Session.bDone = true;
+	Session.DoneEvent->Trigger();
+}
+
+uint32 FLBREncodeScheduler::FWorker::Run()
+{
+	// 连续空转一整轮后才休眠
+	int32 IdleClaims = 0;
+	while (!Owner.bStopping)
+	{
+		FClaim Claim;
+		if (Owner.ClaimWork(Claim))
+		{
+			IdleClaims = Owner.Execute(Claim) ? 0 : IdleClaims + 1;
+			if (IdleClaims < Owner.GetNumSlots())
+			{
+				continue;
+			}
+		}
+
+		IdleClaims = 0;
+		Owner.WorkEvent->Wait(IdleWaitMs);
+	}
+
+	// 把停止信号传给下一个还在等待的线程
+	Owner.WorkEvent->Trigger();
+	return 0;
+}
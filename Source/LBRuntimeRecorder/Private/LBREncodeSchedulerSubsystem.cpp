@@ -0,0 +1,31 @@
+#include "LBREncodeSchedulerSubsystem.h"
+#include "Engine/Engine.h"
+#include "LBREncodeScheduler.h"
+#include "Misc/ScopeLock.h"
+
+void ULBREncodeSchedulerSubsystem::Deinitialize()
+{
+	// 仍在录制的会话会被停止并写完文件
+	Scheduler.Reset();
+	Super::Deinitialize();
+}
+
+ULBREncodeSchedulerSubsystem* ULBREncodeSchedulerSubsystem::Get()
+{
+	return GEngine ? GEngine->GetEngineSubsystem<ULBREncodeSchedulerSubsystem>() : nullptr;
+}
+
+FLBREncodeScheduler& ULBREncodeSchedulerSubsystem::GetScheduler()
+{
+	FScopeLock Lock(&SchedulerMutex);
+	if (!Scheduler.IsValid())
+	{
+		Scheduler = MakeUnique<FLBREncodeScheduler>(Settings);
+	}
+	return *Scheduler;
+}
+
+int32 ULBREncodeSchedulerSubsystem::GetNumActiveSessions() const
+{
+	return Scheduler.IsValid() ? Scheduler->GetNumSessions() : 0;
+}
@@ -1,467 +1,2066 @@
 ﻿#include "LBRFFmpegEncodeThread.h"
+#include "LBRReplayBuffer.h"
+#include "LBRYUVConverter.h"
+#include "HAL/FileManager.h"
 #include "HAL/PlatformProcess.h"
+#include "HAL/RunnableThread.h"
+#include "Async/Async.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
 #include "Logging/LogMacros.h"
 
 DEFINE_LOG_CATEGORY(LogFFmpegEncodeThread);
 
+// 电平汇总日志间隔（秒）
+static constexpr double AudioMeterLogInterval = 5.0;
+
+// 切换后最多等旧段的音频尾巴这么久（秒），音频断流时不至于一直不收尾
+static constexpr double SegmentAudioGraceSeconds = 2.0;
+
+// 某条音频轨落后最快的轨超过这么久（秒）就补静音：submix 自动停用或环溢出时其他轨不被拖住，
+// 同一渲染块内各 submix 回调的先后差异不会触发
+static constexpr double AudioTrackMaxSkewSeconds = 0.05;
+
+// 混音累加环的块数；源轨之间最多相差这么多块，领先的轨先等
+static constexpr int32 DownmixRingBlocks = 16;
+
+static const char* GetMuxerName(ELBRContainerFormat Format)
+{
+    switch (Format)
+    {
+    case ELBRContainerFormat::Matroska:
+        return "matroska";
+
+    case ELBRContainerFormat::MPEGTS:
+        return "mpegts";
+
+    case ELBRContainerFormat::QuickTime:
+        return "mov";
+
+    case ELBRContainerFormat::MP4:
+    case ELBRContainerFormat::FragmentedMP4:
+    default:
+        return "mp4";
+    }
+}
+
+// 编码器支持时取请求的采样率，否则取最接近的（Opus 只有 48k 及其约数）
+// 编码器支持的采样率 / 采样格式，以哨兵结尾，没有限制时为空；61.13 起 AVCodec 上的对应字段已弃用
+static const int* GetSupportedSampleRates(const AVCodec* Codec)
+{
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(61, 13, 100)
+    const void* Configs = nullptr;
+    int NumConfigs = 0;
+    if (avcodec_get_supported_config(nullptr, Codec, AV_CODEC_CONFIG_SAMPLE_RATE, 0, &Configs, &NumConfigs) < 0)
+    {
+        return nullptr;
+    }
+    return static_cast<const int*>(Configs);
+#else
+    return Codec->supported_samplerates;
+#endif
+}
+
+static const AVSampleFormat* GetSupportedSampleFormats(const AVCodec* Codec)
+{
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(61, 13, 100)
+    const void* Configs = nullptr;
+    int NumConfigs = 0;
+    if (avcodec_get_supported_config(nullptr, Codec, AV_CODEC_CONFIG_SAMPLE_FORMAT, 0, &Configs, &NumConfigs) < 0)
+    {
+        return nullptr;
+    }
+    return static_cast<const AVSampleFormat*>(Configs);
+#else
+    return Codec->sample_fmts;
+#endif
+}
+
+static int32 ChooseSampleRate(const AVCodec* Codec, int32 Requested)
+{
+    const int* SupportedRates = GetSupportedSampleRates(Codec);
+    if (!SupportedRates)
+    {
+        return Requested;
+    }
+
+    int32 Best = 0;
+    for (const int* Rate = SupportedRates; *Rate; ++Rate)
+    {
+        if (*Rate == Requested)
+        {
+            return Requested;
+        }
+        if (Best == 0 || FMath::Abs(*Rate - Requested) < FMath::Abs(Best - Requested))
+        {
+            Best = *Rate;
+        }
+    }
+    return Best;
+}
+
+// 优先交错浮点（与 submix 数据一致，可零转换），其次平面浮点；FLAC 只有整数格式，取 32 位存 24 位有效位
+static AVSampleFormat ChooseSampleFormat(const AVCodec* Codec)
+{
+    const AVSampleFormat* SupportedFormats = GetSupportedSampleFormats(Codec);
+    if (!SupportedFormats)
+    {
+        return AV_SAMPLE_FMT_FLTP;
+    }
+
+    for (AVSampleFormat Preferred : { AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_S32 })
+    {
+        for (const AVSampleFormat* Format = SupportedFormats; *Format != AV_SAMPLE_FMT_NONE; ++Format)
+        {
+            if (*Format == Preferred)
+            {
+                return Preferred;
+            }
+        }
+    }
+    return SupportedFormats[0];
+}
+
+// 平面格式每个声道一个指针，交错格式只有 data[0]；Offset 为每声道的样本偏移
+static void GetSamplePointers(const AVFrame* Frame, int32 Offset, uint8** OutPointers)
+{
+    const AVSampleFormat Format = AVSampleFormat(Frame->format);
+    const int32 BytesPerSample = av_get_bytes_per_sample(Format);
+    if (av_sample_fmt_is_planar(Format))
+    {
+        for (int32 Channel = 0; Channel < Frame->ch_layout.nb_channels; ++Channel)
+        {
+            OutPointers[Channel] = Frame->data[Channel] + Offset * BytesPerSample;
+        }
+    }
+    else
+    {
+        OutPointers[0] = Frame->data[0] + Offset * BytesPerSample * Frame->ch_layout.nb_channels;
+    }
+}
+
+// 混音在浮点上累加，整数格式（FLAC）读写时换算并限幅
+static bool IsDownmixFormatSupported(AVSampleFormat Format)
+{
+    const AVSampleFormat Packed = av_get_packed_sample_fmt(Format);
+    return Packed == AV_SAMPLE_FMT_FLT || Packed == AV_SAMPLE_FMT_S16 || Packed == AV_SAMPLE_FMT_S32;
+}
+
+static void AddSamplesToFloat(float* Accum, const uint8* Data, AVSampleFormat Format, int32 Num)
+{
+    switch (av_get_packed_sample_fmt(Format))
+    {
+    case AV_SAMPLE_FMT_FLT:
+    {
+        const float* Samples = reinterpret_cast<const float*>(Data);
+        for (int32 i = 0; i < Num; ++i)
+        {
+            Accum[i] += Samples[i];
+        }
+        break;
+    }
+    case AV_SAMPLE_FMT_S16:
+    {
+        const int16* Samples = reinterpret_cast<const int16*>(Data);
+        for (int32 i = 0; i < Num; ++i)
+        {
+            Accum[i] += Samples[i] * (1.f / 32768.f);
+        }
+        break;
+    }
+    case AV_SAMPLE_FMT_S32:
+    {
+        const int32* Samples = reinterpret_cast<const int32*>(Data);
+        for (int32 i = 0; i < Num; ++i)
+        {
+            Accum[i] += float(Samples[i] * (1.0 / 2147483648.0));
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void StoreFloatSamples(uint8* Data, const float* Accum, AVSampleFormat Format, int32 Num)
+{
+    switch (av_get_packed_sample_fmt(Format))
+    {
+    case AV_SAMPLE_FMT_FLT:
+        FMemory::Memcpy(Data, Accum, Num * sizeof(float));
+        break;
+
+    case AV_SAMPLE_FMT_S16:
+    {
+        int16* Samples = reinterpret_cast<int16*>(Data);
+        for (int32 i = 0; i < Num; ++i)
+        {
+            Samples[i] = int16(FMath::Clamp(FMath::RoundToInt(Accum[i] * 32768.f), -32768, 32767));
+        }
+        break;
+    }
+    case AV_SAMPLE_FMT_S32:
+    {
+        int32* Samples = reinterpret_cast<int32*>(Data);
+        for (int32 i = 0; i < Num; ++i)
+        {
+            Samples[i] = int32(FMath::Clamp(FMath::RoundToDouble(Accum[i] * 2147483648.0), -2147483648.0, 2147483647.0));
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
 FLBRFFmpegEncodeThread::FLBRFFmpegEncodeThread(
     int32 InWidth,
     int32 InHeight,
     int32 InFPS,
-    const FString& InOutputFile
+    const FString& InOutputFile,
+    const FLBREncodeQueueSettings& InQueueSettings,
+    const FLBRVideoEncoderSettings& InVideoSettings,
+    const FLBROutputSettings& InOutputSettings,
+    const FLBRAudioEncoderSettings& InAudioSettings
 )
     : Width(InWidth)
     , Height(InHeight)
     , FPS(InFPS)
     , OutputFile(InOutputFile)
+    , VideoSettings(InVideoSettings)
+    , OutputSettings(InOutputSettings)
+    , AudioSettings(InAudioSettings)
+    , FrameQueue(InQueueSettings.MaxVideoFrames, int64(InQueueSettings.MaxVideoMegabytes) * 1024 * 1024, InQueueSettings.VideoPolicy)
+    , ReorderWindow(InQueueSettings.ReorderWindow)
+    , PacketQueue(256, 64ll * 1024 * 1024, ELBRQueueFullPolicy::BlockProducer)
     , bExit(false)
     , bStopAcceptFrame(false)
-    , FrameIndex(0)
 {
-    FrameEvent = FPlatformProcess::GetSynchEventFromPool(false);
+    StartTime = FPlatformTime::Seconds();
+    PendingSplitPTS.Set(-1);
+    FileWriteCounters = MakeShared<FLBRFileWriteCounters, ESPMode::ThreadSafe>();
+
+    // 每条源轨一个环，按 48kHz、最多 8 声道预分配，音频线程写入时不再分配
+    NumSourceTracks = AudioSettings.GetNumSourceTracks();
+    for (int32 i = 0; i < NumSourceTracks; ++i)
+    {
+        TUniquePtr<FAudioTrack> Track = MakeUnique<FAudioTrack>();
+        Track->Name = AudioSettings.Tracks.IsValidIndex(i) && !AudioSettings.Tracks[i].Name.IsEmpty()
+            ? AudioSettings.Tracks[i].Name
+            : FString::Printf(TEXT("Track %d"), i + 1);
+        Track->Ring = MakeShared<FLBRAudioRing, ESPMode::ThreadSafe>(
+            FMath::CeilToInt(48000 * 8 * FMath::Max(0.1f, InQueueSettings.AudioBufferSeconds)));
+        AudioTracks.Add(MoveTemp(Track));
+    }
+
+    if (AudioSettings.bDownmixTrack && NumSourceTracks > 1)
+    {
+        TUniquePtr<FAudioTrack> Track = MakeUnique<FAudioTrack>();
+        Track->Name = TEXT("Downmix");
+        DownmixTrack = Track.Get();
+        AudioTracks.Add(MoveTemp(Track));
+    }
+
+    for (int32 i = 0; i < AudioTracks.Num(); ++i)
+    {
+        AudioTracks[i]->StreamIndex = VideoStreamIndex + 1 + i;
+    }
+
+    VideoEvent = FPlatformProcess::GetSynchEventFromPool(false);
+    AudioEvent = FPlatformProcess::GetSynchEventFromPool(false);
+    MuxEvent = FPlatformProcess::GetSynchEventFromPool(false);
+}
+
+FLBRFFmpegEncodeThread::~FLBRFFmpegEncodeThread()
+{
+    Cleanup();
+
+    // FinishEncode 之后采集端仍可能调用 PushFrame / Signal，事件与对象同生命周期，不在 Cleanup 中归还
+    for (FEvent** Event : { &VideoEvent, &AudioEvent, &MuxEvent })
+    {
+        if (*Event)
+        {
+            FPlatformProcess::ReturnSynchEventToPool(*Event);
+            *Event = nullptr;
+        }
+    }
+}
+
+bool FLBRFFmpegEncodeThread::Init()
+{
+    // 编码器需要在打开前知道容器是否要全局头；各分段使用同一种容器
+    const AVOutputFormat* OutputFormat = av_guess_format(GetMuxerName(OutputSettings.ContainerFormat), nullptr, nullptr);
+    if (!OutputFormat)
+    {
+        UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Failed to find output format"));
+        return false;
+    }
+
+    const AVCodec* Codec = FindVideoEncoder();
+    if (!Codec)
+    {
+        UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Video encoder not found"));
+        return false;
+    }
+
+    CodecCtx = avcodec_alloc_context3(Codec);
+    CodecCtx->width = Width;
+    CodecCtx->height = Height;
+    CodecCtx->pix_fmt = AV_PIX_FMT_YUV420P;
+    // 可变帧率用更细的时间基承载真实捕获时间
+    CodecCtx->time_base = VideoSettings.bVariableFrameRate ? AVRational{ 1, 90000 } : AVRational{ 1, FPS };
+    CodecCtx->framerate = { FPS, 1 };
+    CodecCtx->gop_size = VideoSettings.GOPLength > 0 ? VideoSettings.GOPLength : FPS;
+    CodecCtx->max_b_frames = VideoSettings.MaxBFrames;
+
+    // 0 = 由编码器自动决定
+    CodecCtx->thread_count = VideoSettings.ThreadCount;
+    CodecCtx->thread_type = VideoSettings.bSliceThreads ? FF_THREAD_SLICE : FF_THREAD_FRAME;
+
+    if (VideoSettings.RateControl == ELBRRateControlMode::Bitrate)
+    {
+        const int64 TargetBps = int64(VideoSettings.TargetBitrateKbps) * 1000;
+        const int64 MaxBps = VideoSettings.MaxBitrateKbps > 0 ? int64(VideoSettings.MaxBitrateKbps) * 1000 : TargetBps;
+        CodecCtx->bit_rate = TargetBps;
+        CodecCtx->rc_max_rate = MaxBps;
+        CodecCtx->rc_buffer_size = VideoSettings.BufferSizeKbits > 0 ? VideoSettings.BufferSizeKbits * 1000 : int(MaxBps * 2);
+    }
+
+    if (OutputFormat->flags & AVFMT_GLOBALHEADER)
+    {
+        CodecCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    VideoPacket = av_packet_alloc();
+    if (!VideoPacket)
+    {
+        UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Failed to alloc AVPacket"));
+        return false;
+    }
+
+    AVDictionary* VideoOptions = nullptr;
+    ApplyVideoSettings(&VideoOptions);
+
+    const int OpenRet = avcodec_open2(CodecCtx, Codec, &VideoOptions);
+
+    // 编码器没有消费的选项留在字典里
+    const AVDictionaryEntry* Unused = nullptr;
+    while ((Unused = av_dict_get(VideoOptions, "", Unused, AV_DICT_IGNORE_SUFFIX)) != nullptr)
+    {
+        UE_LOG(LogFFmpegEncodeThread, Warning, TEXT("%S ignored option %S=%S"), Codec->name, Unused->key, Unused->value);
+    }
+    av_dict_free(&VideoOptions);
+
+    if (OpenRet < 0)
+    {
+        UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Failed to open codec %S"), Codec->name);
+        return false;
+    }
+
+    const FString RateDesc = VideoSettings.RateControl == ELBRRateControlMode::CRF
+        ? FString::Printf(TEXT("crf=%d"), VideoSettings.CRF)
+        : FString::Printf(TEXT("bitrate=%lldk maxrate=%lldk bufsize=%dk"), int64(CodecCtx->bit_rate / 1000), int64(CodecCtx->rc_max_rate / 1000), CodecCtx->rc_buffer_size / 1000);
+    UE_LOG(LogFFmpegEncodeThread, Log, TEXT("Video encoder %S preset=%s tune=%s %s gop=%d bframes=%d threads=%d(%s)"),
+        Codec->name,
+        *VideoSettings.Preset,
+        *VideoSettings.Tune,
+        *RateDesc,
+        CodecCtx->gop_size,
+        CodecCtx->max_b_frames,
+        CodecCtx->thread_count,
+        VideoSettings.bSliceThreads ? TEXT("slice") : TEXT("frame"));
+
+    // ================= Audio Init =================
+    const AVCodec* AudioCodec = FindAudioEncoder(OutputFormat);
+    if (!AudioCodec)
+    {
+        UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Audio encoder not found"));
+        return false;
+    }
+
+    for (TUniquePtr<FAudioTrack>& Track : AudioTracks)
+    {
+        if (!OpenAudioTrack(*Track, AudioCodec, OutputFormat))
+        {
+            return false;
+        }
+    }
+
+    // Swr 在第一块音频到达、知道实际格式后再决定是否创建（InitResampler）
+
+    const FAudioTrack& FirstTrack = *AudioTracks[0];
+    const AVCodecContext* FirstAudioCtx = FirstTrack.CodecCtx;
+    UE_LOG(LogFFmpegEncodeThread, Display,
+        TEXT("Audio %S %dHz %dch %S, frame_size = %d, %d source track(s)%s"),
+        AudioCodec->name, FirstAudioCtx->sample_rate, FirstAudioCtx->ch_layout.nb_channels, av_get_sample_fmt_name(FirstAudioCtx->sample_fmt),
+        FirstTrack.FrameSize, NumSourceTracks, DownmixTrack ? TEXT(" + downmix") : TEXT(""));
+
+    if (DownmixTrack)
+    {
+        // 混音按编码器的样本布局在浮点上累加
+        if (!IsDownmixFormatSupported(FirstAudioCtx->sample_fmt))
+        {
+            UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Downmix does not support sample format %S"), av_get_sample_fmt_name(FirstAudioCtx->sample_fmt));
+            return false;
+        }
+        DownmixAccum.SetNumZeroed(DownmixRingBlocks * FirstTrack.FrameSize * FirstAudioCtx->ch_layout.nb_channels);
+    }
+
+    if (OutputSettings.ReplayBufferSeconds > 0.f)
+    {
+        // 登记顺序与各流序号一致
+        ReplayBuffer = MakeShared<FLBRReplayBuffer, ESPMode::ThreadSafe>(
+            OutputSettings.ReplayBufferSeconds, int64(OutputSettings.ReplayBufferMegabytes) * 1024 * 1024);
+        ReplayBuffer->AddStream(CodecCtx);
+        for (const TUniquePtr<FAudioTrack>& Track : AudioTracks)
+        {
+            ReplayBuffer->AddStream(Track->CodecCtx);
+        }
+    }
+
+    if (!(ReplayBuffer.IsValid() && OutputSettings.bReplayBufferOnly) && !OpenSegment(Segment, 0, 0))
+    {
+        return false;
+    }
+
+    // YUV420P 走 FLBRYUVConverter 单遍转换，其他像素格式才需要 swscale
+    if (CodecCtx->pix_fmt != AV_PIX_FMT_YUV420P)
+    {
+        SwsCtx = sws_getContext(
+            Width,
+            Height,
+            AV_PIX_FMT_BGRA,        // FColor = BGRA
+            Width,
+            Height,
+            CodecCtx->pix_fmt,
+            SWS_POINT,              // 同尺寸转换，不需要插值
+            nullptr,
+            nullptr,
+            nullptr
+        );
+    }
+
+    return AllocFrameRings();
+}
+
+bool FLBRFFmpegEncodeThread::OpenAudioTrack(FAudioTrack& Track, const AVCodec* AudioCodec, const AVOutputFormat* OutputFormat)
+{
+    Track.Packet = av_packet_alloc();
+    if (!Track.Packet)
+    {
+        UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Failed to alloc AVPacket"));
+        return false;
+    }
+
+    // 各轨参数相同，时间基都是 1/采样率，分段偏移可以共用
+    AVCodecContext* Ctx = avcodec_alloc_context3(AudioCodec);
+    Track.CodecCtx = Ctx;
+    Ctx->sample_rate = ChooseSampleRate(AudioCodec, AudioSettings.SampleRate);
+    Ctx->sample_fmt = ChooseSampleFormat(AudioCodec);
+    Ctx->bit_rate = int64(AudioSettings.BitrateKbps) * 1000;
+    Ctx->time_base = { 1, Ctx->sample_rate };
+
+    if (Ctx->codec_id == AV_CODEC_ID_FLAC && Ctx->sample_fmt == AV_SAMPLE_FMT_S32)
+    {
+        Ctx->bits_per_raw_sample = 24;
+    }
+    if (AudioCodec->capabilities & AV_CODEC_CAP_EXPERIMENTAL)
+    {
+        Ctx->strict_std_compliance = FF_COMPLIANCE_EXPERIMENTAL;
+    }
+
+    av_channel_layout_default(&Ctx->ch_layout, FMath::Clamp(AudioSettings.NumChannels, 1, 8));
+
+    if (OutputFormat->flags & AVFMT_GLOBALHEADER)
+    {
+        Ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+
+    if (avcodec_open2(Ctx, AudioCodec, nullptr) < 0)
+    {
+        UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Failed to open %S codec for %s"), AudioCodec->name, *Track.Name);
+        return false;
+    }
+
+    // PCM 等可变帧长的编码器 frame_size 为 0，按固定块切
+    Track.FrameSize = Ctx->frame_size > 0 ? Ctx->frame_size : 1024;
+    return true;
+}
+
+const AVCodec* FLBRFFmpegEncodeThread::FindAudioEncoder(const AVOutputFormat* OutputFormat) const
+{
+    AVCodecID CodecId = AV_CODEC_ID_AAC;
+    switch (AudioSettings.Codec)
+    {
+    case ELBRAudioCodec::Opus:
+        CodecId = AV_CODEC_ID_OPUS;
+        break;
+
+    case ELBRAudioCodec::FLAC:
+        CodecId = AV_CODEC_ID_FLAC;
+        break;
+
+    case ELBRAudioCodec::PCM:
+        CodecId = AV_CODEC_ID_PCM_F32LE;
+        break;
+
+    default:
+        break;
+    }
+
+    // 明确不支持才回退；查询不到（TS 等没有编码表的容器）时照常尝试
+    if (CodecId != AV_CODEC_ID_AAC && avformat_query_codec(OutputFormat, CodecId, FF_COMPLIANCE_NORMAL) == 0)
+    {
+        UE_LOG(LogFFmpegEncodeThread, Warning, TEXT("Container %S cannot store %S audio, falling back to AAC"),
+            OutputFormat->name, avcodec_get_name(CodecId));
+        CodecId = AV_CODEC_ID_AAC;
+    }
+
+    // Opus 优先用 libopus，内置编码器仍是实验性的
+    const AVCodec* Codec = CodecId == AV_CODEC_ID_OPUS ? avcodec_find_encoder_by_name("libopus") : nullptr;
+    if (!Codec)
+    {
+        Codec = avcodec_find_encoder(CodecId);
+    }
+    if (!Codec && CodecId != AV_CODEC_ID_AAC)
+    {
+        UE_LOG(LogFFmpegEncodeThread, Warning, TEXT("%S encoder not available, falling back to AAC"), avcodec_get_name(CodecId));
+        Codec = avcodec_find_encoder(AV_CODEC_ID_AAC);
+    }
+    return Codec;
+}
+
+const AVCodec* FLBRFFmpegEncodeThread::FindVideoEncoder() const
+{
+    const AVCodec* Codec = nullptr;
+    if (!VideoSettings.EncoderName.IsEmpty())
+    {
+        Codec = avcodec_find_encoder_by_name(TCHAR_TO_UTF8(*VideoSettings.EncoderName));
+        if (!Codec)
+        {
+            UE_LOG(LogFFmpegEncodeThread, Warning, TEXT("Encoder %s not found, falling back to default H264"), *VideoSettings.EncoderName);
+        }
+    }
+
+    if (!Codec)
+    {
+        Codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+    }
+    return Codec;
+}
+
+void FLBRFFmpegEncodeThread::ApplyVideoSettings(AVDictionary** Options) const
+{
+    // preset / tune / crf 是编码器私有选项，各编码器取值范围不同
+    if (!VideoSettings.Preset.IsEmpty())
+    {
+        av_dict_set(Options, "preset", TCHAR_TO_UTF8(*VideoSettings.Preset), 0);
+    }
+
+    if (!VideoSettings.Tune.IsEmpty())
+    {
+        av_dict_set(Options, "tune", TCHAR_TO_UTF8(*VideoSettings.Tune), 0);
+    }
+
+    if (VideoSettings.RateControl == ELBRRateControlMode::CRF)
+    {
+        av_dict_set_int(Options, "crf", VideoSettings.CRF, 0);
+    }
+}
+
+void FLBRFFmpegEncodeThread::ApplyMuxerOptions(AVDictionary** Options) const
+{
+    // 空 moov 开头，之后每个关键帧写一个 moof + mdat，索引不再在内存里累积
+    if (OutputSettings.ContainerFormat == ELBRContainerFormat::FragmentedMP4)
+    {
+        av_dict_set(Options, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+    }
+}
+
+void FLBRFFmpegEncodeThread::CommitOutputFile(const FString& InFinalFile)
+{
+    {
+        FScopeLock Lock(&OutputFileLock);
+        FinalOutputFile = InFinalFile;
+    }
+
+    // 第一帧随后才推入队列，视频阶段经队列的锁看到新零点
+    StartTime = FPlatformTime::Seconds();
+}
+
+FString FLBRFFmpegEncodeThread::GetTargetOutputFile() const
+{
+    FScopeLock Lock(&OutputFileLock);
+    return FinalOutputFile.IsEmpty() ? OutputFile : FinalOutputFile;
+}
+
+FString FLBRFFmpegEncodeThread::MakeSegmentPath(const FString& BaseFile, int32 Index) const
+{
+    if (!OutputSettings.IsSegmented())
+    {
+        return BaseFile;
+    }
+
+    const FString SegmentName = FString::Printf(TEXT("%s_%03d%s"), *FPaths::GetBaseFilename(BaseFile), Index, *FPaths::GetExtension(BaseFile, true));
+    return FPaths::Combine(FPaths::GetPath(BaseFile), SegmentName);
+}
+
+bool FLBRFFmpegEncodeThread::OpenSegment(FSegment& OutSegment, int32 Index, int64 VideoOffset)
+{
+    const FString FilePath = MakeSegmentPath(GetTargetOutputFile(), Index);
+
+    // 目录在这里（编码 / mux 线程）创建，游戏线程不碰文件系统
+    IFileManager::Get().MakeDirectory(*FPaths::GetPath(FilePath), true);
+
+    AVFormatContext* Ctx = nullptr;
+    avformat_alloc_output_context2(&Ctx, nullptr, GetMuxerName(OutputSettings.ContainerFormat), TCHAR_TO_UTF8(*FilePath));
+    if (!Ctx)
+    {
+        UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Failed to create format context"));
+        return false;
+    }
+
+    // 顺序与各流序号一致
+    AVStream* VideoStream = avformat_new_stream(Ctx, nullptr);
+    avcodec_parameters_from_context(VideoStream->codecpar, CodecCtx);
+    VideoStream->time_base = CodecCtx->time_base;
+
+    for (const TUniquePtr<FAudioTrack>& Track : AudioTracks)
+    {
+        AVStream* Stream = avformat_new_stream(Ctx, nullptr);
+        avcodec_parameters_from_context(Stream->codecpar, Track->CodecCtx);
+        Stream->time_base = Track->CodecCtx->time_base;
+
+        // 剪辑软件按标题区分分轨；有混音轨时播放器默认放混音轨，否则放第一条
+        av_dict_set(&Stream->metadata, "title", TCHAR_TO_UTF8(*Track->Name), 0);
+        av_dict_set(&Stream->metadata, "handler_name", TCHAR_TO_UTF8(*Track->Name), 0);
+        const FAudioTrack* DefaultTrack = DownmixTrack ? DownmixTrack : AudioTracks[0].Get();
+        Stream->disposition = Track.Get() == DefaultTrack ? AV_DISPOSITION_DEFAULT : 0;
+    }
+
+    FLBRAsyncFileWriterPtr Writer;
+    if (!(Ctx->oformat->flags & AVFMT_NOFILE))
+    {
+        bool bOpened = false;
+        if (OutputSettings.bWriteBehindIO)
+        {
+            Writer = MakeShared<FLBRAsyncFileWriter, ESPMode::ThreadSafe>(FileWriteCounters, OutputSettings.WriteBufferMegabytes, OutputSettings.bDirectIO);
+            bOpened = Writer->Open(FilePath);
+            if (bOpened)
+            {
+                // pb 归 writer 所有，avformat 不会去关闭它
+                Ctx->pb = Writer->GetAVIOContext();
+                Ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+            }
+        }
+        else
+        {
+            bOpened = avio_open(&Ctx->pb, TCHAR_TO_UTF8(*FilePath), AVIO_FLAG_WRITE) >= 0;
+        }
+
+        if (!bOpened)
+        {
+            UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Failed to open output file %s"), *FilePath);
+            Writer.Reset();
+            avformat_free_context(Ctx);
+            return false;
+        }
+    }
+
+    AVDictionary* MuxerOptions = nullptr;
+    ApplyMuxerOptions(&MuxerOptions);
+
+    const int Ret = avformat_write_header(Ctx, &MuxerOptions);
+
+    const AVDictionaryEntry* UnusedMuxerOption = nullptr;
+    while ((UnusedMuxerOption = av_dict_get(MuxerOptions, "", UnusedMuxerOption, AV_DICT_IGNORE_SUFFIX)) != nullptr)
+    {
+        UE_LOG(LogFFmpegEncodeThread, Warning, TEXT("%S ignored option %S=%S"), Ctx->oformat->name, UnusedMuxerOption->key, UnusedMuxerOption->value);
+    }
+    av_dict_free(&MuxerOptions);
+
+    if (Ret < 0)
+    {
+        UE_LOG(LogFFmpegEncodeThread, Error, TEXT("avformat_write_header failed: %d"), Ret);
+        CloseSegmentFile(Ctx, Writer);
+        return false;
+    }
+
+    OutSegment.FormatCtx = Ctx;
+    OutSegment.Writer = MoveTemp(Writer);
+    OutSegment.KeyframeIndex = OutputSettings.bWriteKeyframeIndex ? MakeShared<FLBRKeyframeIndex, ESPMode::ThreadSafe>() : nullptr;
+    OutSegment.FilePath = FilePath;
+    OutSegment.Index = Index;
+    OutSegment.VideoOffset = VideoOffset;
+    OutSegment.AudioOffset = av_rescale_q(VideoOffset, CodecCtx->time_base, AudioTracks[0]->CodecCtx->time_base);
+    return true;
+}
+
+void FLBRFFmpegEncodeThread::CloseSegmentFile(AVFormatContext*& Ctx, FLBRAsyncFileWriterPtr& Writer)
+{
+    if (!Ctx)
+    {
+        return;
+    }
+
+    if (Writer.IsValid())
+    {
+        // 等写线程把剩余数据落盘后才算关闭
+        if (!Writer->Close())
+        {
+            UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Write-behind I/O reported errors"));
+        }
+        Ctx->pb = nullptr;
+        Writer.Reset();
+    }
+    else if (!(Ctx->oformat->flags & AVFMT_NOFILE))
+    {
+        avio_closep(&Ctx->pb);
+    }
+    avformat_free_context(Ctx);
+    Ctx = nullptr;
+}
+
+void FLBRFFmpegEncodeThread::FinalizeSegment(FSegment& InSegment, bool bAsync)
+{
+    AVFormatContext* Ctx = InSegment.FormatCtx;
+    InSegment.FormatCtx = nullptr;
+    if (!Ctx)
+    {
+        return;
+    }
+
+    // 预热时写的是临时文件，收尾时改名到正式路径；取消时为空，直接删除
+    const FString TargetPath = bDiscardOutput ? FString() : MakeSegmentPath(GetTargetOutputFile(), InSegment.Index);
+
+    // 收尾只用到自身持有的上下文，回调按值拷贝，不依赖编码器状态
+    auto Finish = [Ctx, Writer = MoveTemp(InSegment.Writer), KeyframeIndex = MoveTemp(InSegment.KeyframeIndex), FilePath = InSegment.FilePath, TargetPath, Index = InSegment.Index, Callback = OnSegmentFinished]() mutable
+    {
+        const int Ret = av_write_trailer(Ctx);
+        if (Ret < 0)
+        {
+            UE_LOG(LogFFmpegEncodeThread, Error, TEXT("av_write_trailer failed for %s: %d"), *FilePath, Ret);
+        }
+        CloseSegmentFile(Ctx, Writer);
+
+        if (TargetPath.IsEmpty())
+        {
+            IFileManager::Get().Delete(*FilePath, false, true, true);
+            return;
+        }
+
+        if (TargetPath != FilePath)
+        {
+            IFileManager::Get().MakeDirectory(*FPaths::GetPath(TargetPath), true);
+            if (IFileManager::Get().Move(*TargetPath, *FilePath))
+            {
+                FilePath = TargetPath;
+            }
+            else
+            {
+                UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Failed to move %s to %s, keeping the temporary file"), *FilePath, *TargetPath);
+            }
+        }
+
+        // 索引先于回调落盘，回调里拿到的文件总是带着索引
+        if (KeyframeIndex.IsValid() && !KeyframeIndex->Save(FilePath))
+        {
+            UE_LOG(LogFFmpegEncodeThread, Warning, TEXT("Failed to write keyframe index for %s"), *FilePath);
+        }
+
+        if (Callback)
+        {
+            Callback(FilePath, Index);
+        }
+    };
+
+    if (!bAsync)
+    {
+        Finish();
+        return;
+    }
+
+    // FinishEncode 返回前会等这些任务完成；顺便丢掉已完成的
+    PendingFinalizations.RemoveAll([](const TFuture<void>& Pending) { return Pending.IsReady(); });
+    PendingFinalizations.Add(Async(EAsyncExecution::ThreadPool, [Finish = MoveTemp(Finish)]() mutable
+        {
+            Finish();
+        }));
+}
+
+bool FLBRFFmpegEncodeThread::AllocFrameRings()
+{
+    for (int32 i = 0; i < FrameRingSize; ++i)
+    {
+        AVFrame* Frame = av_frame_alloc();
+        if (!Frame)
+        {
+            UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Failed to alloc video AVFrame"));
+            return false;
+        }
+        VideoFrameRing.Add(Frame);
+
+        Frame->format = CodecCtx->pix_fmt;
+        Frame->width = CodecCtx->width;
+        Frame->height = CodecCtx->height;
+
+        if (av_frame_get_buffer(Frame, 32) < 0)
+        {
+            UE_LOG(LogFFmpegEncodeThread, Error, TEXT("av_frame_get_buffer failed"));
+            return false;
+        }
+        FramesAllocated.Increment();
+    }
+
+    for (TUniquePtr<FAudioTrack>& Track : AudioTracks)
+    {
+        const AVCodecContext* AudioCtx = Track->CodecCtx;
+        for (int32 i = 0; i < FrameRingSize; ++i)
+        {
+            AVFrame* Frame = av_frame_alloc();
+            if (!Frame)
+            {
+                UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Failed to alloc audio AVFrame"));
+                return false;
+            }
+            Track->FrameRing.Add(Frame);
+
+            Frame->nb_samples = Track->FrameSize;
+            Frame->format = AudioCtx->sample_fmt;
+            Frame->sample_rate = AudioCtx->sample_rate;
+            av_channel_layout_copy(&Frame->ch_layout, &AudioCtx->ch_layout);
+
+            if (av_frame_get_buffer(Frame, 0) < 0)
+            {
+                UE_LOG(LogFFmpegEncodeThread, Error, TEXT("av_frame_get_buffer(audio) failed"));
+                return false;
+            }
+            FramesAllocated.Increment();
+        }
+    }
+
+    return true;
+}
+
+AVFrame* FLBRFFmpegEncodeThread::AcquireRingFrame(TArray<AVFrame*>& Ring, int32& RingIndex)
+{
+    if (Ring.Num() == 0)
+    {
+        return nullptr;
+    }
+
+    AVFrame* Frame = Ring[RingIndex];
+    RingIndex = (RingIndex + 1) % Ring.Num();
+
+    // 编码器仍引用该缓冲时才重新分配（x264 / aac 通常会拷贝输入，稳定后不会走到这里）
+    if (!av_frame_is_writable(Frame))
+    {
+        if (av_frame_make_writable(Frame) < 0)
+        {
+            UE_LOG(LogFFmpegEncodeThread, Error, TEXT("av_frame_make_writable failed"));
+            return nullptr;
+        }
+        FramesAllocated.Increment();
+    }
+
+    return Frame;
+}
+
+void FLBRFFmpegEncodeThread::FStageCounters::Add(uint64 Cycles)
+{
+    Processed.Increment();
+    BusyCycles.Add(int64(Cycles));
+    if (int64(Cycles) > MaxCycles.GetValue())
+    {
+        MaxCycles.Set(int64(Cycles));
+    }
+}
+
+uint32 FLBRFFmpegEncodeThread::Run()
+{
+    VideoStageRunnable = new FStageRunnable([this]() { RunVideoStage(); });
+    AudioStageRunnable = new FStageRunnable([this]() { RunAudioStage(); });
+    VideoStageThread = FRunnableThread::Create(VideoStageRunnable, TEXT("LBR_VideoEncodeStage"), 0, TPri_Normal);
+    AudioStageThread = FRunnableThread::Create(AudioStageRunnable, TEXT("LBR_AudioEncodeStage"), 0, TPri_Normal);
+
+    // 本线程即 mux 阶段：两个编码阶段都结束且包队列清空后才写 trailer
+    int32 Processed = 0;
+    while (!StepMuxStage(MAX_int32, Processed))
+    {
+        MuxEvent->Wait();
+    }
+
+    JoinStageThreads();
+    FinishEncode();
+
+    return 0;
+}
+
+void FLBRFFmpegEncodeThread::AttachScheduler(FEvent* InWakeEvent, int32 InCodecThreads)
+{
+    SchedulerEvent = InWakeEvent;
+
+    // 工作线程不能阻塞在包队列上等同一会话的 mux 时间片；上限由 StepStage 在时间片开始前检查，
+    // 一个时间片内最多超出 MaxItems 帧产生的包，超出部分只计数
+    PacketQueue.SetPolicy(ELBRQueueFullPolicy::NeverDrop);
+
+    if (VideoSettings.ThreadCount == 0 && InCodecThreads > 0)
+    {
+        VideoSettings.ThreadCount = InCodecThreads;
+    }
+}
+
+bool FLBRFFmpegEncodeThread::StepStage(EStage Stage, int32 MaxItems, int32& OutProcessed)
+{
+    // 包队列已满时让出时间片，等 mux 消费后再编码
+    if (Stage != EStage::Mux && PacketQueue.IsFull())
+    {
+        OutProcessed = 0;
+        return false;
+    }
+
+    switch (Stage)
+    {
+    case EStage::Video:
+        return StepVideoStage(MaxItems, OutProcessed);
+
+    case EStage::Audio:
+        return StepAudioStage(MaxItems, OutProcessed);
+
+    case EStage::Mux:
+    default:
+        return StepMuxStage(MaxItems, OutProcessed);
+    }
+}
+
+void FLBRFFmpegEncodeThread::FinishEncode()
+{
+    FinalizeSegment(ClosingSegment, false);
+    FinalizeSegment(Segment, false);
+
+    // 后台收尾的旧段全部关闭后才返回，StopRecording 返回时所有文件都已完整
+    for (TFuture<void>& Pending : PendingFinalizations)
+    {
+        Pending.Wait();
+    }
+    PendingFinalizations.Empty();
+
+    if (OutputSettings.bWriteBehindIO)
+    {
+        const FLBRFileWriteStats WriteStats = GetFileWriteStats();
+        UE_LOG(LogFFmpegEncodeThread, Log,
+            TEXT("File write: Written=%lld bytes Writes=%lld Avg=%.2fms Max=%.2fms PeakPending=%lld bytes Stalls=%lld Errors=%lld"),
+            WriteStats.BytesWritten, WriteStats.Writes, WriteStats.AvgWriteMs, WriteStats.MaxWriteMs,
+            WriteStats.PeakBytesPending, WriteStats.ProducerStalls, WriteStats.Errors);
+    }
+
+    if (ReplayBuffer.IsValid())
+    {
+        UE_LOG(LogFFmpegEncodeThread, Log, TEXT("Replay buffer: %.1fs buffered (%lld bytes), %lld packets evicted"),
+            ReplayBuffer->GetBufferedSeconds(), ReplayBuffer->GetBufferedBytes(), ReplayBuffer->GetEvictedPackets());
+    }
+
+    if (DroppedLateAudioPackets > 0)
+    {
+        UE_LOG(LogFFmpegEncodeThread, Warning, TEXT("Dropped %lld audio packets that arrived after their segment was closed"), DroppedLateAudioPackets);
+    }
+
+    UE_LOG(LogFFmpegEncodeThread, Log, TEXT("Encode finished, AVFrame buffers allocated = %lld"), FramesAllocated.GetValue());
+
+    const FLBRBoundedQueueStats VideoStats = FrameQueue.GetStats();
+    UE_LOG(LogFFmpegEncodeThread, Log,
+        TEXT("Video queue: Pushed=%lld Blocked=%lld DroppedOldest=%lld DroppedNewest=%lld OverCap=%lld Peak=%d (%lld bytes)"),
+        VideoStats.Pushed, VideoStats.Blocked, VideoStats.DroppedOldest, VideoStats.DroppedNewest, VideoStats.OverCap, VideoStats.PeakNum, VideoStats.PeakBytes);
+    for (int32 i = 0; i < NumSourceTracks; ++i)
+    {
+        const FAudioTrack& Track = *AudioTracks[i];
+        UE_LOG(LogFFmpegEncodeThread, Log,
+            TEXT("Audio ring [%s]: Capacity=%d Written=%lld Overflowed=%lld PaddedSilence=%lld samples"),
+            *Track.Name, Track.Ring->GetCapacity(), Track.Ring->GetTotalWritten(), Track.Ring->GetOverflowedSamples(), Track.PaddedSamples);
+    }
+
+    LogStageStats(TEXT("Video encode"), GetVideoStageStats());
+    LogStageStats(TEXT("Audio encode"), GetAudioStageStats());
+    LogStageStats(TEXT("Mux"), GetMuxStageStats());
+
+    UE_LOG(LogFFmpegEncodeThread, Log, TEXT("Duplicate frames elided = %lld (%s timestamps)"),
+        ElidedFrames.GetValue(), VideoSettings.bVariableFrameRate ? TEXT("VFR") : TEXT("CFR"));
+
+    const FLBRReorderStats& Reorder = ReorderWindow.GetStats();
+    UE_LOG(LogFFmpegEncodeThread, Log,
+        TEXT("Reorder: Released=%lld OutOfOrder=%lld Skipped=%lld Late=%lld Dropped=%lld PeakPending=%d MaxCaptureLatency=%.1fms"),
+        Reorder.Released, Reorder.OutOfOrder, Reorder.Skipped, Reorder.Late, Reorder.Dropped, Reorder.PeakPending, MaxCaptureLatency * 1000.0);
+
+    Cleanup();
+}
+
+bool FLBRFFmpegEncodeThread::IsDuplicateOfLast(const FLBRRawFrame& Frame) const
+{
+    if (!VideoSettings.bSkipDuplicateFrames || !CodecCtx || Frame.PixelHash == 0 || LastVideoPTS < 0)
+    {
+        return false;
+    }
+
+    // 调色参数变了即使像素相同，输出也不同
+    return Frame.PixelHash == LastPixelHash && Frame.ToneLUT == LastToneLUT;
+}
+
+int64 FLBRFFmpegEncodeThread::ComputeVideoPTS(const FLBRRawFrame& Frame)
+{
+    int64 PTS = Frame.PTS;
+    if (VideoSettings.bVariableFrameRate)
+    {
+        const double Elapsed = FMath::Max(0.0, Frame.CaptureTime - StartTime);
+        PTS = FMath::RoundToInt64(Elapsed * CodecCtx->time_base.den / CodecCtx->time_base.num);
+    }
+
+    // 编码器要求严格递增
+    if (PTS <= LastVideoPTS)
+    {
+        PTS = LastVideoPTS + 1;
+    }
+    LastVideoPTS = PTS;
+    return PTS;
+}
+
+bool FLBRFFmpegEncodeThread::IsRolloverDue(int64 PTS)
+{
+    // 上一次切换还没被 mux 执行前不再发起新的
+    if (!OutputSettings.IsSegmented() || PendingSplitPTS.GetValue() >= 0)
+    {
+        return false;
+    }
+
+    if (bSizeRolloverDue)
+    {
+        bSizeRolloverDue = false;
+        return true;
+    }
+
+    const double SegmentSeconds = (PTS - SegmentStartPTS) * av_q2d(CodecCtx->time_base);
+    return OutputSettings.SegmentMinutes > 0.f && SegmentSeconds >= OutputSettings.SegmentMinutes * 60.0;
+}
+
+void FLBRFFmpegEncodeThread::JoinStageThreads()
+{
+    if (VideoStageThread)
+    {
+        VideoStageThread->WaitForCompletion();
+        delete VideoStageThread;
+        VideoStageThread = nullptr;
+    }
+
+    if (AudioStageThread)
+    {
+        AudioStageThread->WaitForCompletion();
+        delete AudioStageThread;
+        AudioStageThread = nullptr;
+    }
+
+    delete VideoStageRunnable;
+    VideoStageRunnable = nullptr;
+    delete AudioStageRunnable;
+    AudioStageRunnable = nullptr;
+}
+
+void FLBRFFmpegEncodeThread::RunVideoStage()
+{
+    int32 Processed = 0;
+    while (!StepVideoStage(MAX_int32, Processed))
+    {
+        VideoEvent->Wait();
+    }
+}
+
+void FLBRFFmpegEncodeThread::RunAudioStage()
+{
+    int32 Processed = 0;
+    while (!StepAudioStage(MAX_int32, Processed))
+    {
+        // 音频线程写环时不触发事件（避免在音频线程上加锁），这里按 AAC 帧时长的一半轮询
+        AudioEvent->Wait(10);
+    }
+}
+
+bool FLBRFFmpegEncodeThread::StepVideoStage(int32 MaxItems, int32& OutProcessed)
+{
+    // 先读退出标志再清空队列，保证退出前入队的帧都被编码；时间片用完说明队列可能还有帧
+    const bool bExitRequested = bExit;
+    OutProcessed = PumpVideo(MaxItems);
+    if (!bExitRequested || OutProcessed >= MaxItems)
+    {
+        return false;
+    }
+
+    // 已不会再有新帧，剩下的按序全部编码
+    FLBRRawFrame Frame;
+    while (ReorderWindow.PopAny(Frame))
+    {
+        EncodeOrderedFrame(Frame);
+    }
+
+    // 最后一段是重复帧时补编最后一帧，否则文件时长会停在上一次编码的帧
+    if (LastElidedFrame.Buffer.IsValid())
+    {
+        EncodeOneFrame(LastElidedFrame);
+    }
+
+    FlushVideoEncoder();
+    bVideoStageDone = true;
+    Signal(MuxEvent);
+    return true;
+}
+
+bool FLBRFFmpegEncodeThread::StepAudioStage(int32 MaxItems, int32& OutProcessed)
+{
+    const bool bExitRequested = bExit;
+    OutProcessed = PumpAudio(MaxItems);
+    if (!bExitRequested || OutProcessed >= MaxItems)
+    {
+        return false;
+    }
+
+    FlushAudioEncoder();
+    bAudioStageDone = true;
+    Signal(MuxEvent);
+    return true;
+}
+
+bool FLBRFFmpegEncodeThread::StepMuxStage(int32 MaxItems, int32& OutProcessed)
+{
+    const bool bStagesDone = bVideoStageDone && bAudioStageDone;
+    OutProcessed = PumpMux(MaxItems);
+    return bStagesDone && OutProcessed < MaxItems;
+}
+
+void FLBRFFmpegEncodeThread::ReleaseReadyFrames()
+{
+    {
+        FScopeLock Lock(&DroppedSequencesLock);
+        for (const int64 Sequence : DroppedSequences)
+        {
+            ReorderWindow.MarkDropped(Sequence);
+        }
+        DroppedSequences.Reset();
+    }
+
+    FLBRRawFrame Frame;
+    while (ReorderWindow.PopReady(Frame))
+    {
+        EncodeOrderedFrame(Frame);
+    }
+}
+
+int32 FLBRFFmpegEncodeThread::PumpVideo(int32 MaxItems)
+{
+    // 没有新帧时也要处理丢帧报告，窗口里等缺口的帧可能已经可以放行
+    ReleaseReadyFrames();
+
+    int32 NumPopped = 0;
+    FLBRRawFrame Frame;
+    while (NumPopped < MaxItems && FrameQueue.Pop(Frame))
+    {
+        NumPopped++;
+        if (!ReorderWindow.Insert(Frame.Sequence, MoveTemp(Frame)))
+        {
+            UE_LOG(LogFFmpegEncodeThread, Verbose, TEXT("Late frame dropped, Sequence=%lld PTS=%lld"), Frame.Sequence, Frame.PTS);
+        }
+
+        ReleaseReadyFrames();
+    }
+    return NumPopped;
+}
+
+void FLBRFFmpegEncodeThread::EncodeOrderedFrame(FLBRRawFrame& Frame)
+{
+    MaxCaptureLatency = FMath::Max(MaxCaptureLatency, FPlatformTime::Seconds() - Frame.CaptureTime);
+
+    // 重复帧不编码，下一帧的 PTS 自然把上一帧的显示时间延长；每个 GOP 至少编一帧，保证关键帧间隔
+    if (IsDuplicateOfLast(Frame) && ConsecutiveElided + 1 < CodecCtx->gop_size)
+    {
+        ConsecutiveElided++;
+        ElidedFrames.Increment();
+        LastElidedFrame = MoveTemp(Frame);
+        return;
+    }
+
+    ConsecutiveElided = 0;
+    LastElidedFrame = FLBRRawFrame();
+    LastPixelHash = Frame.PixelHash;
+    LastToneLUT = Frame.ToneLUT;
+
+    const uint64 StartCycles = FPlatformTime::Cycles64();
+    EncodeOneFrame(Frame);
+    VideoStage.Add(FPlatformTime::Cycles64() - StartCycles);
+}
+
+FLBREncodeStageStats FLBRFFmpegEncodeThread::GetAudioStageStats() const
+{
+    int32 Pending = 0;
+    for (int32 i = 0; i < NumSourceTracks; ++i)
+    {
+        Pending += AudioTracks[i]->Ring->NumReadable();
+    }
+    return AudioStage.Snapshot(Pending, 0);
+}
+
+int32 FLBRFFmpegEncodeThread::PumpAudio(int32 MaxItems)
+{
+    if (AudioTracks.Num() == 0 || !AudioTracks[0]->CodecCtx)
+    {
+        return 0;
+    }
+
+    AlignAudioTrackStarts();
+    if (!bAudioClockBaseSet)
+    {
+        return 0;
+    }
+
+    for (int32 i = 0; i < NumSourceTracks; ++i)
+    {
+        ResampleIntoFifo(*AudioTracks[i], false);
+    }
+
+    // 落后最快的轨太多（submix 停用、环溢出）就补静音，不让一条轨拖住其他轨和混音
+    const int64 MaxSkew = int64(AudioTracks[0]->CodecCtx->sample_rate * AudioTrackMaxSkewSeconds);
+    int64 LeadEnd = 0;
+    for (int32 i = 0; i < NumSourceTracks; ++i)
+    {
+        const FAudioTrack& Track = *AudioTracks[i];
+        LeadEnd = FMath::Max(LeadEnd, Track.NextPTS + Track.PendingSilence + GetReadableFrames(Track));
+    }
+    for (int32 i = 0; i < NumSourceTracks; ++i)
+    {
+        FAudioTrack& Track = *AudioTracks[i];
+        const int64 Gap = LeadEnd - (Track.NextPTS + Track.PendingSilence + GetReadableFrames(Track));
+        if (Gap > MaxSkew)
+        {
+            Track.PendingSilence += Gap;
+        }
+    }
+
+    // 各源轨轮流各编一块，混音轨跟在最慢的源轨后面
+    int32 NumBlocks = 0;
+    bool bProgress = true;
+    while (NumBlocks < MaxItems && bProgress)
+    {
+        bProgress = false;
+        for (int32 i = 0; i < NumSourceTracks && NumBlocks < MaxItems; ++i)
+        {
+            FAudioTrack& Track = *AudioTracks[i];
+            if (!HasAudioBlock(Track))
+            {
+                continue;
+            }
+
+            const uint64 StartCycles = FPlatformTime::Cycles64();
+            EncodeTrackBlock(Track, false);
+            AudioStage.Add(FPlatformTime::Cycles64() - StartCycles);
+            NumBlocks++;
+            bProgress = true;
+        }
+        EncodeReadyDownmix();
+    }
+
+    if (NumBlocks > 0)
+    {
+        const double Now = FPlatformTime::Seconds();
+        for (int32 i = 0; i < NumSourceTracks; ++i)
+        {
+            AudioTracks[i]->Meter.LogSummaryIfDue(Now, AudioMeterLogInterval);
+        }
+    }
+    return NumBlocks;
+}
+
+void FLBRFFmpegEncodeThread::AlignAudioTrackStarts()
+{
+    for (int32 i = 0; i < NumSourceTracks; ++i)
+    {
+        FAudioTrack& Track = *AudioTracks[i];
+        if (Track.InputChannels == 0)
+        {
+            const int32 NumChannels = Track.Ring->GetNumChannels();
+            if (NumChannels <= 0 || !InitResampler(Track, NumChannels, Track.Ring->GetSampleRate()))
+            {
+                continue;
+            }
+        }
+
+        double FirstClock = 0.0;
+        if (Track.bStarted || !Track.Ring->GetFirstClock(FirstClock))
+        {
+            continue;
+        }
+
+        // 最早有数据的轨定零点，其余轨按首样本时钟差落到同一时间轴上
+        if (!bAudioClockBaseSet)
+        {
+            AudioClockBase = FirstClock;
+            bAudioClockBaseSet = true;
+        }
+
+        const int64 StartPTS = FMath::RoundToInt64((FirstClock - AudioClockBase) * Track.CodecCtx->sample_rate);
+        const int64 Cursor = Track.NextPTS + Track.PendingSilence;
+        if (StartPTS >= Cursor)
+        {
+            Track.PendingSilence += StartPTS - Cursor;
+        }
+        else
+        {
+            // 之前补的静音多了（或时钟略早于零点），先退静音，不够再丢环里的样本
+            const int64 Excess = Cursor - StartPTS;
+            const int64 FromSilence = FMath::Min(Excess, Track.PendingSilence);
+            Track.PendingSilence -= FromSilence;
+            Track.PendingSkip += Excess - FromSilence;
+        }
+        Track.bStarted = true;
+
+        UE_LOG(LogFFmpegEncodeThread, Log, TEXT("Audio track [%s] starts at %lld samples (%d ch)"),
+            *Track.Name, StartPTS, Track.InputChannels);
+    }
+}
+
+int64 FLBRFFmpegEncodeThread::GetReadableFrames(const FAudioTrack& Track) const
+{
+    if (!Track.bStarted || Track.InputChannels <= 0)
+    {
+        return 0;
+    }
+    const int64 Available = Track.Fifo ? av_audio_fifo_size(Track.Fifo) : Track.Ring->NumReadable() / Track.InputChannels;
+    return FMath::Max<int64>(0, Available - Track.PendingSkip);
+}
+
+bool FLBRFFmpegEncodeThread::HasAudioBlock(const FAudioTrack& Track) const
+{
+    // 混音累加环装不下就先等最慢的轨
+    if (DownmixTrack && Track.NextPTS - DownmixNextPTS >= int64(DownmixRingBlocks - 1) * Track.FrameSize)
+    {
+        return false;
+    }
+    return Track.PendingSilence + GetReadableFrames(Track) >= Track.FrameSize;
+}
+
+void FLBRFFmpegEncodeThread::ResampleIntoFifo(FAudioTrack& Track, bool bFlush)
+{
+    if (!Track.Fifo)
+    {
+        return;
+    }
+
+    const int32 Channels = Track.InputChannels;
+    int32 Frames = Track.Ring->NumReadable() / Channels;
+    while (Frames > 0)
+    {
+        const int32 Chunk = FMath::Min(Frames, Track.FrameSize);
+        const float* Data = Track.Ring->Peek(Chunk * Channels, Track.Scratch.GetData());
+        Track.Meter.Process(Data, Chunk, Channels);
+
+        const uint8* InData[1] = { reinterpret_cast<const uint8*>(Data) };
+        const int Converted = swr_convert(Track.SwrCtx, Track.ResampleFrame->data, Track.ResampleFrame->nb_samples, InData, Chunk);
+        Track.Ring->Consume(Chunk * Channels);
+        if (Converted > 0)
+        {
+            av_audio_fifo_write(Track.Fifo, reinterpret_cast<void**>(Track.ResampleFrame->data), Converted);
+        }
+        Frames -= Chunk;
+    }
+
+    // 收尾时取出重采样器内部缓冲的尾巴
+    int Converted = 0;
+    while (bFlush && (Converted = swr_convert(Track.SwrCtx, Track.ResampleFrame->data, Track.ResampleFrame->nb_samples, nullptr, 0)) > 0)
+    {
+        av_audio_fifo_write(Track.Fifo, reinterpret_cast<void**>(Track.ResampleFrame->data), Converted);
+    }
+}
+
+void FLBRFFmpegEncodeThread::EncodeTrackBlock(FAudioTrack& Track, bool bPadTail)
+{
+    const int32 FrameSize = Track.FrameSize;
+    const int32 Channels = Track.InputChannels;
+
+    if (Track.PendingSkip > 0 && Channels > 0)
+    {
+        const int64 Available = Track.Fifo ? av_audio_fifo_size(Track.Fifo) : Track.Ring->NumReadable() / Channels;
+        const int32 Skip = int32(FMath::Min<int64>(Track.PendingSkip, Available));
+        if (Track.Fifo)
+        {
+            av_audio_fifo_drain(Track.Fifo, Skip);
+        }
+        else
+        {
+            Track.Ring->Consume(Skip * Channels);
+        }
+        Track.PendingSkip = bPadTail ? 0 : Track.PendingSkip - Skip;
+    }
+
+    // 块内先放待补的静音，再接环（或 FIFO）里的数据，收尾时不足一块补零
+    const int32 SilenceFrames = int32(FMath::Min<int64>(Track.PendingSilence, FrameSize));
+    const int32 DataFrames = int32(FMath::Min<int64>(FrameSize - SilenceFrames, GetReadableFrames(Track)));
+    check(bPadTail || SilenceFrames + DataFrames == FrameSize);
+
+    // PCM 直通：整块都在环里时直接打包，不经过 AVFrame 和编码器
+    if (Track.bDirectPCM && DataFrames == FrameSize)
+    {
+        const float* Block = Track.Ring->Peek(FrameSize * Channels, Track.Scratch.GetData());
+        Track.Meter.Process(Block, FrameSize, Channels);
+        SubmitPCMPacket(Track, Block);
+        Track.Ring->Consume(FrameSize * Channels);
+        return;
+    }
+
+    AVFrame* Frame = AcquireRingFrame(Track.FrameRing, Track.FrameRingIndex);
+    if (!Frame)
+    {
+        return;
+    }
+
+    Track.PendingSilence -= SilenceFrames;
+    Track.PaddedSamples += FrameSize - DataFrames;
+
+    const AVCodecContext* Ctx = Track.CodecCtx;
+    if (DataFrames < FrameSize)
+    {
+        av_samples_set_silence(Frame->data, 0, FrameSize, Ctx->ch_layout.nb_channels, Ctx->sample_fmt);
+    }
+
+    if (DataFrames > 0)
+    {
+        uint8* Dest[AV_NUM_DATA_POINTERS] = {};
+        GetSamplePointers(Frame, SilenceFrames, Dest);
+
+        if (Track.Fifo)
+        {
+            av_audio_fifo_read(Track.Fifo, reinterpret_cast<void**>(Dest), DataFrames);
+        }
+        else
+        {
+            // 不跨越环尾时直接读环内存，跨越时才拼到 Scratch
+            const float* Data = Track.Ring->Peek(DataFrames * Channels, Track.Scratch.GetData());
+            Track.Meter.Process(Data, DataFrames, Channels);
+
+            if (Track.SwrCtx)
+            {
+                // 声道映射 / 交错转平面，采样率相同时输入输出样本数一致
+                const uint8* InData[1] = { reinterpret_cast<const uint8*>(Data) };
+                if (swr_convert(Track.SwrCtx, Dest, DataFrames, InData, DataFrames) <= 0)
+                {
+                    UE_LOG(LogFFmpegEncodeThread, Error, TEXT("swr_convert failed"));
+                }
+            }
+            else
+            {
+                // 与编码器格式完全一致，零转换
+                FMemory::Memcpy(Dest[0], Data, DataFrames * Channels * sizeof(float));
+            }
+            Track.Ring->Consume(DataFrames * Channels);
+        }
+    }
+
+    SubmitAudioFrame(Track, Frame, DataFrames > 0);
 }
 
-FLBRFFmpegEncodeThread::~FLBRFFmpegEncodeThread()
+int32 FLBRFFmpegEncodeThread::PumpMux(int32 MaxItems)
 {
-    Cleanup();
+    int32 NumPackets = 0;
+    FLBRAVPacketPtr Pkt;
+    while (NumPackets < MaxItems && PacketQueue.Pop(Pkt))
+    {
+        const uint64 StartCycles = FPlatformTime::Cycles64();
+        MuxPacket(Pkt.Get());
+        Pkt.Reset();
+        MuxStage.Add(FPlatformTime::Cycles64() - StartCycles);
+        NumPackets++;
+    }
+    return NumPackets;
 }
 
-bool FLBRFFmpegEncodeThread::Init()
+void FLBRFFmpegEncodeThread::MuxPacket(AVPacket* Pkt)
 {
-    avformat_alloc_output_context2(
-        &FormatCtx,
-        nullptr,
-        "mp4",
-        TCHAR_TO_UTF8(*OutputFile)
-    );
-
-    if (!FormatCtx)
+    // 写文件会改时间戳并交出引用，先在回放缓冲里留一份引用
+    if (ReplayBuffer.IsValid())
     {
-        UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Failed to create format context"));
-        return false;
+        ReplayBuffer->Add(Pkt);
     }
 
-    const AVCodec* Codec = avcodec_find_encoder(AV_CODEC_ID_H264);
-    if (!Codec)
+    if (!Segment.FormatCtx)
     {
-        UE_LOG(LogFFmpegEncodeThread, Error, TEXT("H264 encoder not found"));
-        return false;
+        return;
     }
 
-    CodecCtx = avcodec_alloc_context3(Codec);
-    CodecCtx->width = Width;
-    CodecCtx->height = Height;
-    CodecCtx->pix_fmt = AV_PIX_FMT_YUV420P;
-    CodecCtx->time_base = { 1, FPS };
-    CodecCtx->framerate = { FPS, 1 };
-    CodecCtx->gop_size = FPS;
-    CodecCtx->max_b_frames = 0;
-
-    Packet = av_packet_alloc();
-    if (!Packet)
+    if (Pkt->stream_index == VideoStreamIndex)
     {
-        UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Failed to alloc AVPacket"));
-        return false;
+        // 视频阶段为切换强制的关键帧到了：从它开始写进新文件
+        const int64 SplitPTS = PendingSplitPTS.GetValue();
+        if (SplitPTS >= 0 && (Pkt->flags & AV_PKT_FLAG_KEY) && Pkt->pts >= SplitPTS)
+        {
+            RollOver(Pkt->pts);
+            PendingSplitPTS.Set(-1);
+        }
+        else if (ClosingSegment.FormatCtx &&
+            (Pkt->pts - Segment.VideoOffset) * av_q2d(CodecCtx->time_base) > SegmentAudioGraceSeconds)
+        {
+            FinalizeSegment(ClosingSegment, true);
+        }
+
+        WriteToSegment(Segment, Pkt);
     }
+    else
+    {
+        // 切换时刻之前的音频仍属于旧段；等到第一个属于新段的音频包才让旧段收尾
+        if (Pkt->pts < Segment.AudioOffset)
+        {
+            if (ClosingSegment.FormatCtx)
+            {
+                WriteToSegment(ClosingSegment, Pkt);
+            }
+            else if (Segment.Index > 0)
+            {
+                DroppedLateAudioPackets++;
+            }
+            else
+            {
+                // 首段零点之前只有编码器的起始延迟
+                WriteToSegment(Segment, Pkt);
+            }
+            return;
+        }
 
-    // 可选：降低延迟
-    av_opt_set(CodecCtx->priv_data, "preset", "ultrafast", 0);
+        // 每条音频流都有包越过切换点后旧段才收尾
+        if (ClosingSegment.FormatCtx)
+        {
+            NewSegmentAudioStreams |= 1ull << Pkt->stream_index;
+
+            uint64 AllAudioStreams = 0;
+            for (const TUniquePtr<FAudioTrack>& Track : AudioTracks)
+            {
+                AllAudioStreams |= 1ull << Track->StreamIndex;
+            }
+            if (NewSegmentAudioStreams == AllAudioStreams)
+            {
+                FinalizeSegment(ClosingSegment, true);
+            }
+        }
+        WriteToSegment(Segment, Pkt);
+    }
 
-    if (avcodec_open2(CodecCtx, Codec, nullptr) < 0)
+    if (OutputSettings.SegmentMegabytes > 0 && Segment.FormatCtx->pb && !bSizeRolloverDue && PendingSplitPTS.GetValue() < 0 &&
+        avio_tell(Segment.FormatCtx->pb) >= int64(OutputSettings.SegmentMegabytes) * 1024 * 1024)
     {
-        UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Failed to open codec"));
-        return false;
+        bSizeRolloverDue = true;
     }
+}
 
-    VideoStream = avformat_new_stream(FormatCtx, nullptr);
-    avcodec_parameters_from_context(VideoStream->codecpar, CodecCtx);
-    VideoStream->time_base = CodecCtx->time_base;
+void FLBRFFmpegEncodeThread::WriteToSegment(FSegment& InSegment, AVPacket* Pkt)
+{
+    const bool bVideo = Pkt->stream_index == VideoStreamIndex;
+    const AVCodecContext* Encoder = GetStreamEncoder(Pkt->stream_index);
+    const int64 Offset = bVideo ? InSegment.VideoOffset : InSegment.AudioOffset;
 
-    if (!(FormatCtx->oformat->flags & AVFMT_NOFILE))
+    if (Pkt->pts != AV_NOPTS_VALUE)
     {
-        if (avio_open(&FormatCtx->pb, TCHAR_TO_UTF8(*OutputFile), AVIO_FLAG_WRITE) < 0)
-        {
-            UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Failed to open output file"));
-            return false;
-        }
+        Pkt->pts -= Offset;
     }
-
-    // ================= Audio Init =================
-    const AVCodec* AudioCodec = avcodec_find_encoder(AV_CODEC_ID_AAC);
-    if (!AudioCodec)
+    if (Pkt->dts != AV_NOPTS_VALUE)
     {
-        UE_LOG(LogFFmpegEncodeThread, Error, TEXT("AAC encoder not found"));
-        return false;
+        Pkt->dts -= Offset;
     }
 
-    AudioCodecCtx = avcodec_alloc_context3(AudioCodec);
-    AudioCodecCtx->sample_rate = 48000;          // UE 默认
-    AudioCodecCtx->sample_fmt = AudioCodec->sample_fmts[0]; // 通常 FLTP
-    AudioCodecCtx->bit_rate = 128000;
-    AudioCodecCtx->time_base = { 1, AudioCodecCtx->sample_rate };
+    // 交错缓冲会推迟写出，此处的位置只是关键帧实际位置的下界，ExtractClip 从这里向后找关键帧即可
+    if (bVideo && (Pkt->flags & AV_PKT_FLAG_KEY) && InSegment.KeyframeIndex.IsValid() && Pkt->pts != AV_NOPTS_VALUE)
+    {
+        InSegment.KeyframeIndex->Add(av_rescale_q(Pkt->pts, Encoder->time_base, AV_TIME_BASE_Q),
+            InSegment.FormatCtx->pb ? avio_tell(InSegment.FormatCtx->pb) : -1);
+    }
 
-    av_channel_layout_default(&AudioCodecCtx->ch_layout, 2);
+    av_packet_rescale_ts(Pkt, Encoder->time_base, InSegment.FormatCtx->streams[Pkt->stream_index]->time_base);
 
-    if (FormatCtx->oformat->flags & AVFMT_GLOBALHEADER)
+    // av_interleaved_write_frame 接管包内数据的引用，按 dts 交错两路流
+    const int Ret = av_interleaved_write_frame(InSegment.FormatCtx, Pkt);
+    if (Ret < 0)
     {
-        AudioCodecCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+        UE_LOG(LogFFmpegEncodeThread, Error, TEXT("av_interleaved_write_frame failed: %d"), Ret);
     }
+}
 
-    if (avcodec_open2(AudioCodecCtx, AudioCodec, nullptr) < 0)
+bool FLBRFFmpegEncodeThread::SaveReplay(const FString& FilePath, float Seconds, FOnReplaySaved&& OnSaved)
+{
+    if (!ReplayBuffer.IsValid())
     {
-        UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Failed to open AAC codec"));
         return false;
     }
+    return ReplayBuffer->SaveAsync(FilePath, GetMuxerName(OutputSettings.ContainerFormat), Seconds, MoveTemp(OnSaved));
+}
 
-    AudioStream = avformat_new_stream(FormatCtx, nullptr);
-    avcodec_parameters_from_context(AudioStream->codecpar, AudioCodecCtx);
-    AudioStream->time_base = AudioCodecCtx->time_base;
-
-    // ===== Swr =====
-    SwrCtx = swr_alloc();
-
-    AVChannelLayout InLayout;
-    av_channel_layout_default(&InLayout, 2);
-
-    swr_alloc_set_opts2(
-        &SwrCtx,
-        &AudioCodecCtx->ch_layout,
-        AudioCodecCtx->sample_fmt,
-        AudioCodecCtx->sample_rate,
-        &InLayout,
-        AV_SAMPLE_FMT_FLT, // 不是AV_SAMPLE_FMT_S16
-        AudioCodecCtx->sample_rate,
-        0,
-        nullptr
-    );
-
-    swr_init(SwrCtx);
-
-    // AAC 必须有固定 frame_size
-    check(AudioCodecCtx->frame_size > 0);
-    UE_LOG(LogFFmpegEncodeThread, Display,
-        TEXT("AAC frame_size = %d"), AudioCodecCtx->frame_size);
+void FLBRFFmpegEncodeThread::RollOver(int64 KeyframePTS)
+{
+    // 上一段的音频尾巴还没等到就又要切换，直接收尾
+    FinalizeSegment(ClosingSegment, true);
 
-    int Ret = avformat_write_header(FormatCtx, nullptr);
-    if (Ret < 0)
+    FSegment Next;
+    if (!OpenSegment(Next, Segment.Index + 1, KeyframePTS))
     {
-        UE_LOG(LogFFmpegEncodeThread, Error, TEXT("avformat_write_header failed: %d"), Ret);
-        return false;
+        // 打不开新文件就继续写当前段，不丢数据
+        UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Segment rollover failed, continuing %s"), *Segment.FilePath);
+        return;
     }
 
-    SwsCtx = sws_getContext(
-        Width,
-        Height,
-        AV_PIX_FMT_BGRA,        // FColor = BGRA
-        Width,
-        Height,
-        AV_PIX_FMT_YUV420P,
-        SWS_BILINEAR,
-        nullptr,
-        nullptr,
-        nullptr
-    );
+    UE_LOG(LogFFmpegEncodeThread, Log, TEXT("Segment %d -> %s at %.3fs"),
+        Segment.Index, *Next.FilePath, KeyframePTS * av_q2d(CodecCtx->time_base));
 
-    return true;
+    ClosingSegment = MoveTemp(Segment);
+    Segment = MoveTemp(Next);
+    NewSegmentAudioStreams = 0;
 }
 
-uint32 FLBRFFmpegEncodeThread::Run()
+AVCodecContext* FLBRFFmpegEncodeThread::GetStreamEncoder(int32 StreamIndex) const
 {
-    while (!bExit || !FrameQueue.IsEmpty())
+    if (StreamIndex == VideoStreamIndex)
     {
-        if (FrameEvent)
-        {
-            FrameEvent->Wait();
-            FrameEvent->Reset();  // 等待下次唤醒
-        }
+        return CodecCtx;
+    }
+    const int32 Track = StreamIndex - VideoStreamIndex - 1;
+    return AudioTracks.IsValidIndex(Track) ? AudioTracks[Track]->CodecCtx : nullptr;
+}
 
-        FLBRRawFrame Frame;
-        while (FrameQueue.Dequeue(Frame))
-        {
-            EncodeOneFrame(Frame);
-        }
+void FLBRFFmpegEncodeThread::DrainEncoder(AVCodecContext* Ctx, int32 StreamIndex, AVPacket* Pkt)
+{
+    while (avcodec_receive_packet(Ctx, Pkt) == 0)
+    {
+        Pkt->stream_index = StreamIndex;
 
-        FLBRAudioFrame AudioFrame;
-        while (AudioQueue.Dequeue(AudioFrame))
+        // 转移引用，不拷贝数据
+        FLBRAVPacketPtr Out(av_packet_alloc());
+        if (!Out)
         {
-            EncodeOneAudioFrame(AudioFrame);
+            av_packet_unref(Pkt);
+            continue;
         }
-    }
+        av_packet_move_ref(Out.Get(), Pkt);
 
-    FlushEncoder();
-    if (FormatCtx)
-    {
-        av_write_trailer(FormatCtx);
+        const int64 PacketBytes = Out->size;
+        PacketQueue.Push(MoveTemp(Out), PacketBytes);
+        Signal(MuxEvent);
     }
-    Cleanup();
+}
 
-    return 0;
+void FLBRFFmpegEncodeThread::LogStageStats(const TCHAR* Name, const FLBREncodeStageStats& Stats) const
+{
+    UE_LOG(LogFFmpegEncodeThread, Log,
+        TEXT("%s stage: Processed=%lld Busy=%.3fs Avg=%.3fms Max=%.3fms PeakQueue=%d"),
+        Name,
+        Stats.Processed,
+        Stats.BusySeconds,
+        Stats.Processed > 0 ? Stats.BusySeconds * 1000.0 / Stats.Processed : 0.0,
+        Stats.MaxSeconds * 1000.0,
+        Stats.PeakQueueDepth);
 }
 
 void FLBRFFmpegEncodeThread::Stop()
 {
     bExit = true;
-    if (FrameEvent)
+    for (FEvent* Event : { VideoEvent, AudioEvent, MuxEvent })
     {
-        FrameEvent->Trigger();
+        Signal(Event);
     }
 }
 
-void FLBRFFmpegEncodeThread::StopRecording()
+void FLBRFFmpegEncodeThread::Signal(FEvent* StageEvent)
 {
-    bStopAcceptFrame = true;
-    bExit = true;
-    if (FrameEvent)
+    if (StageEvent)
     {
-        FrameEvent->Trigger();
+        StageEvent->Trigger();
     }
+    if (SchedulerEvent)
+    {
+        SchedulerEvent->Trigger();
+    }
+}
+
+void FLBRFFmpegEncodeThread::StopRecording()
+{
+    bStopAcceptFrame = true;
+
+    // 先关闭队列（唤醒阻塞中的生产者），之后不会再有帧进来，阶段线程看到 bExit 后清空队列即可退出
+    FrameQueue.Close();
+
+    Stop();
 }
 
-void FLBRFFmpegEncodeThread::PushFrame(FLBRRawFrame&& Frame)
+ELBRPushResult FLBRFFmpegEncodeThread::PushFrame(FLBRRawFrame&& Frame)
 {
     if (bStopAcceptFrame)
-        return;
+        return ELBRPushResult::Rejected;
 
-    FrameQueue.Enqueue(MoveTemp(Frame));
-    if (FrameEvent)
+    const int64 FrameBytes = Frame.Buffer.IsValid() ? int64(Frame.Buffer->Pixels.Num()) * sizeof(FColor) : 0;
+    const int64 Sequence = Frame.Sequence;
+    TArray<FLBRRawFrame> Evicted;
+    const ELBRPushResult Result = FrameQueue.Push(MoveTemp(Frame), FrameBytes, &Evicted);
+
+    // 队列丢掉的帧同样要告诉重排窗口，否则它会一直等到窗口满
+    if (Result == ELBRPushResult::DroppedNewest || Evicted.Num() > 0)
     {
-        FrameEvent->Trigger();
+        FScopeLock Lock(&DroppedSequencesLock);
+        if (Result == ELBRPushResult::DroppedNewest)
+        {
+            DroppedSequences.Add(Sequence);
+        }
+        for (const FLBRRawFrame& Dropped : Evicted)
+        {
+            DroppedSequences.Add(Dropped.Sequence);
+        }
     }
+
+    Signal(VideoEvent);
+    return Result;
 }
 
-void FLBRFFmpegEncodeThread::PushAudioFrame(FLBRAudioFrame&& Frame)
+void FLBRFFmpegEncodeThread::ReportDroppedFrame(int64 Sequence)
 {
     if (bStopAcceptFrame)
         return;
 
-    AudioQueue.Enqueue(MoveTemp(Frame));
-
-    if (FrameEvent)
     {
-        FrameEvent->Trigger();
+        FScopeLock Lock(&DroppedSequencesLock);
+        DroppedSequences.Add(Sequence);
     }
+    Signal(VideoEvent);
 }
 
-void FLBRFFmpegEncodeThread::EncodeOneFrame(const FLBRRawFrame& Raw)
+void FLBRFFmpegEncodeThread::EncodeOneFrame(FLBRRawFrame& Raw)
 {
-    if (!CodecCtx)
+    if (!CodecCtx || !VideoPacket || !Raw.Buffer.IsValid())
+        return;
+
+    AVFrame* Frame = AcquireRingFrame(VideoFrameRing, VideoFrameRingIndex);
+    if (!Frame)
         return;
 
-    AVFrame* Frame = av_frame_alloc();
-    Frame->format = CodecCtx->pix_fmt;
-    Frame->width = CodecCtx->width;
-    Frame->height = CodecCtx->height;
-    Frame->pts = FrameIndex++;
+    // 帧号 / 捕获时间在发起捕获时确定，经重排后严格递增；被丢弃或合并的帧留下时间空洞而不是把后面的帧提前
+    Frame->pts = ComputeVideoPTS(Raw);
 
-    int Ret = av_frame_get_buffer(Frame, 32);
-    if (Ret < 0)
+    // 到了分段时长或大小：本帧强制为关键帧，mux 阶段在它处切换到新文件
+    Frame->pict_type = AV_PICTURE_TYPE_NONE;
+    if (IsRolloverDue(Frame->pts))
     {
-        UE_LOG(LogFFmpegEncodeThread, Error, TEXT("av_frame_get_buffer failed"));
-        av_frame_free(&Frame);
-        return;
+        Frame->pict_type = AV_PICTURE_TYPE_I;
+        SegmentStartPTS = Frame->pts;
+        PendingSplitPTS.Set(Frame->pts);
     }
 
-    uint8* SrcData[] =
+    if (SwsCtx)
     {
-        reinterpret_cast<uint8*>(const_cast<FColor*>(Raw.Pixels.GetData()))
-    };
+        if (Raw.ToneLUT.IsValid())
+        {
+            Raw.ToneLUT->ApplyParallel(Raw.Buffer->Pixels.GetData(), Raw.Width, Raw.Height);
+        }
+
+        uint8* SrcData[] =
+        {
+            reinterpret_cast<uint8*>(Raw.Buffer->Pixels.GetData())
+        };
+
+        int SrcStride[] =
+        {
+            Raw.Width * 4
+        };
 
-    int SrcStride[] =
+        sws_scale(
+            SwsCtx,
+            SrcData,
+            SrcStride,
+            0,
+            Raw.Height,
+            Frame->data,
+            Frame->linesize
+        );
+    }
+    else
     {
-        Raw.Width * 4
-    };
+        // 调色 + BGRA -> YUV420P 一遍完成，直接写进编码器的 AVFrame
+        FLBRYUV420Planes Planes;
+        Planes.Y = Frame->data[0];
+        Planes.U = Frame->data[1];
+        Planes.V = Frame->data[2];
+        Planes.YStride = Frame->linesize[0];
+        Planes.UStride = Frame->linesize[1];
+        Planes.VStride = Frame->linesize[2];
+
+        // Raw.Width 是回读的行距（像素），可能大于编码宽度
+        FLBRYUVConverter::Convert(
+            Raw.Buffer->Pixels.GetData(),
+            Raw.Width,
+            FMath::Min(Raw.Width, CodecCtx->width),
+            FMath::Min(Raw.Height, CodecCtx->height),
+            Raw.ToneLUT.Get(),
+            Planes
+        );
+    }
 
-    sws_scale(
-        SwsCtx,
-        SrcData,
-        SrcStride,
-        0,
-        Raw.Height,
-        Frame->data,
-        Frame->linesize
-    );
+    // 像素已转成 YUV，尽早把缓冲还给池
+    Raw.Buffer.SafeRelease();
 
     avcodec_send_frame(CodecCtx, Frame);
+    DrainEncoder(CodecCtx, VideoStreamIndex, VideoPacket);
+}
 
-    while (avcodec_receive_packet(CodecCtx, Packet) == 0)
-    {
-        av_packet_rescale_ts(
-            Packet,
-            CodecCtx->time_base,
-            VideoStream->time_base
-        );
+void FLBRFFmpegEncodeThread::SubmitAudioFrame(FAudioTrack& Track, AVFrame* Frame, bool bHasData)
+{
+    Frame->pts = Track.NextPTS;
+    Track.NextPTS += Track.FrameSize;
 
-        Packet->stream_index = VideoStream->index;
-        av_interleaved_write_frame(FormatCtx, Packet);
-        av_packet_unref(Packet);
+    // 静音块不累加，混音槽里对应位置保持为零
+    if (DownmixTrack && bHasData)
+    {
+        AccumulateDownmix(Frame->pts, Frame->data);
     }
 
-    av_frame_free(&Frame);
+    SendAudioFrame(Track, Frame);
 }
 
-void FLBRFFmpegEncodeThread::EncodeOneAudioFrame(const FLBRAudioFrame& InAudio)
+void FLBRFFmpegEncodeThread::SubmitPCMPacket(FAudioTrack& Track, const float* Interleaved)
 {
-    if (!AudioCodecCtx || !AudioStream || !SwrCtx || !Packet)
+    const int64 PTS = Track.NextPTS;
+    Track.NextPTS += Track.FrameSize;
+
+    if (DownmixTrack)
     {
-        return;
+        const uint8* Planes[1] = { reinterpret_cast<const uint8*>(Interleaved) };
+        AccumulateDownmix(PTS, Planes);
     }
 
-    const int32 NumChannels = InAudio.NumChannels;
-    if (NumChannels <= 0)
+    const int32 Bytes = Track.FrameSize * Track.InputChannels * int32(sizeof(float));
+    FLBRAVPacketPtr Out(av_packet_alloc());
+    if (!Out || av_new_packet(Out.Get(), Bytes) < 0)
     {
+        UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Failed to alloc PCM packet"));
         return;
     }
 
-    // 1️ 先把 UE 给的 samples 全部攒起来
-    PendingAudioSamples.Append(InAudio.Samples);
+    FMemory::Memcpy(Out->data, Interleaved, Bytes);
+    Out->pts = PTS;
+    Out->dts = PTS;
+    Out->duration = Track.FrameSize;
+    Out->flags |= AV_PKT_FLAG_KEY;
+    Out->stream_index = Track.StreamIndex;
+
+    PacketQueue.Push(MoveTemp(Out), Bytes);
+    Signal(MuxEvent);
+}
+
+void FLBRFFmpegEncodeThread::AccumulateDownmix(int64 PTS, const uint8* const* Data)
+{
+    const AVCodecContext* Ctx = DownmixTrack->CodecCtx;
+    const int32 FrameSize = DownmixTrack->FrameSize;
+    const int32 NumChannels = Ctx->ch_layout.nb_channels;
+
+    // 槽内按编码器的样本布局存放：平面格式逐声道一段，交错格式整块一段
+    const bool bPlanar = av_sample_fmt_is_planar(Ctx->sample_fmt) != 0;
+    const int32 NumPlanes = bPlanar ? NumChannels : 1;
+    const int32 PlaneSamples = bPlanar ? FrameSize : FrameSize * NumChannels;
 
-    const int32 AACFrameSamplesPerChannel = AudioCodecCtx->frame_size; // 1024
-    const int32 AACFrameSamplesTotal = AACFrameSamplesPerChannel * NumChannels;
+    float* Slot = DownmixAccum.GetData() + int32((PTS / FrameSize) % DownmixRingBlocks) * FrameSize * NumChannels;
+    for (int32 Plane = 0; Plane < NumPlanes; ++Plane)
+    {
+        AddSamplesToFloat(Slot + Plane * PlaneSamples, Data[Plane], Ctx->sample_fmt, PlaneSamples);
+    }
+}
 
-    // 2️ 只在「攒够 1024 * channel」时才送 AAC
-    while (PendingAudioSamples.Num() >= AACFrameSamplesTotal)
+void FLBRFFmpegEncodeThread::SendAudioFrame(FAudioTrack& Track, AVFrame* Frame)
+{
+    // ---- 送给 AAC ----
+    int Ret = avcodec_send_frame(Track.CodecCtx, Frame);
+    if (Ret < 0)
     {
-        // ---- 创建 AVFrame ----
-        AVFrame* AVAudioFrame = av_frame_alloc();
-        AVAudioFrame->nb_samples = AACFrameSamplesPerChannel;
-        AVAudioFrame->format = AudioCodecCtx->sample_fmt;
-        AVAudioFrame->sample_rate = AudioCodecCtx->sample_rate;
-        AVAudioFrame->ch_layout = AudioCodecCtx->ch_layout;
-        AVAudioFrame->pts = AudioFrameIndex;
+        char Err[AV_ERROR_MAX_STRING_SIZE];
+        av_strerror(Ret, Err, sizeof(Err));
+        UE_LOG(LogFFmpegEncodeThread, Error,
+            TEXT("avcodec_send_frame(audio) failed: %S"), Err);
 
-        AudioFrameIndex += AACFrameSamplesPerChannel;
+        return;
+    }
 
-        if (av_frame_get_buffer(AVAudioFrame, 0) < 0)
-        {
-            UE_LOG(LogFFmpegEncodeThread, Error, TEXT("av_frame_get_buffer(audio) failed"));
-            av_frame_free(&AVAudioFrame);
-            return;
-        }
+    // ---- 收包，交给 mux 阶段 ----
+    DrainEncoder(Track.CodecCtx, Track.StreamIndex, Track.Packet);
+}
 
-        // ---- 输入数据（S16 interleaved）----
-        const uint8* InData[1] =
-        {
-            reinterpret_cast<const uint8*>(PendingAudioSamples.GetData())
-        };
+void FLBRFFmpegEncodeThread::EncodeReadyDownmix()
+{
+    if (!DownmixTrack)
+    {
+        return;
+    }
 
-        // ---- 重采样 / 格式转换 ----
-        int Converted = swr_convert(
-            SwrCtx,
-            AVAudioFrame->data,
-            AACFrameSamplesPerChannel,
-            InData,
-            AACFrameSamplesPerChannel
-        );
+    // 所有源轨都已越过的块才算齐；静音块不累加，对应位置保持为零
+    int64 ReadyPTS = MAX_int64;
+    for (int32 i = 0; i < NumSourceTracks; ++i)
+    {
+        ReadyPTS = FMath::Min(ReadyPTS, AudioTracks[i]->NextPTS);
+    }
 
-        if (Converted <= 0)
-        {
-            UE_LOG(LogFFmpegEncodeThread, Error, TEXT("swr_convert failed"));
-            av_frame_free(&AVAudioFrame);
-            return;
-        }
+    const AVCodecContext* Ctx = DownmixTrack->CodecCtx;
+    const int32 FrameSize = DownmixTrack->FrameSize;
+    const int32 NumChannels = Ctx->ch_layout.nb_channels;
+    const bool bPlanar = av_sample_fmt_is_planar(Ctx->sample_fmt) != 0;
+    const int32 NumPlanes = bPlanar ? NumChannels : 1;
+    const int32 PlaneSamples = bPlanar ? FrameSize : FrameSize * NumChannels;
 
-        // ---- 送给 AAC ----
-        int Ret = avcodec_send_frame(AudioCodecCtx, AVAudioFrame);
-        if (Ret < 0)
+    while (DownmixNextPTS + FrameSize <= ReadyPTS)
+    {
+        AVFrame* Frame = AcquireRingFrame(DownmixTrack->FrameRing, DownmixTrack->FrameRingIndex);
+        if (!Frame)
         {
-            char Err[AV_ERROR_MAX_STRING_SIZE];
-            av_strerror(Ret, Err, sizeof(Err));
-            UE_LOG(LogFFmpegEncodeThread, Error,
-                TEXT("avcodec_send_frame(audio) failed: %S"), Err);
-
-            av_frame_free(&AVAudioFrame);
             return;
         }
 
-        // ---- 收包 ----
-        while (avcodec_receive_packet(AudioCodecCtx, Packet) == 0)
+        float* Slot = DownmixAccum.GetData() + int32((DownmixNextPTS / FrameSize) % DownmixRingBlocks) * FrameSize * NumChannels;
+        for (int32 Plane = 0; Plane < NumPlanes; ++Plane)
         {
-            av_packet_rescale_ts(
-                Packet,
-                AudioCodecCtx->time_base,
-                AudioStream->time_base
-            );
-
-            Packet->stream_index = AudioStream->index;
-            av_interleaved_write_frame(FormatCtx, Packet);
-            av_packet_unref(Packet);
+            StoreFloatSamples(Frame->data[Plane], Slot + Plane * PlaneSamples, Ctx->sample_fmt, PlaneSamples);
         }
+        FMemory::Memzero(Slot, FrameSize * NumChannels * sizeof(float));
 
-        av_frame_free(&AVAudioFrame);
-
-        // ---- 从缓存中移除已消费的 samples ----
-        PendingAudioSamples.RemoveAt(
-            0,
-            AACFrameSamplesTotal,
-            EAllowShrinking::No
-        );
+        Frame->pts = DownmixNextPTS;
+        DownmixNextPTS += FrameSize;
+        DownmixTrack->NextPTS = DownmixNextPTS;
+        SendAudioFrame(*DownmixTrack, Frame);
     }
 }
 
-
-
-void FLBRFFmpegEncodeThread::FlushEncoder()
+bool FLBRFFmpegEncodeThread::InitResampler(FAudioTrack& Track, int32 InNumChannels, int32 InSampleRate)
 {
-    if (!Packet)
-        return;
+    const AVCodecContext* Ctx = Track.CodecCtx;
+    const bool bResample = InSampleRate != Ctx->sample_rate;
+    Track.Scratch.SetNumUninitialized(Track.FrameSize * InNumChannels);
 
-    // ================== Flush Video ==================
-    if (CodecCtx && VideoStream)
+    // 采样率、声道数、交错浮点都与编码器一致：不建 Swr，块直接拷进 AVFrame，PCM 直接打包
+    if (!bResample && InNumChannels == Ctx->ch_layout.nb_channels && Ctx->sample_fmt == AV_SAMPLE_FMT_FLT)
     {
-        avcodec_send_frame(CodecCtx, nullptr);
+        Track.bDirectPCM = Ctx->codec_id == AV_CODEC_ID_PCM_F32LE;
+        Track.InputChannels = InNumChannels;
+        UE_LOG(LogFFmpegEncodeThread, Log, TEXT("Audio track [%s]: %dHz %dch, no conversion%s"),
+            *Track.Name, InSampleRate, InNumChannels, Track.bDirectPCM ? TEXT(" (PCM passthrough)") : TEXT(""));
+        return true;
+    }
 
-        while (avcodec_receive_packet(CodecCtx, Packet) == 0)
-        {
-            av_packet_rescale_ts(
-                Packet,
-                CodecCtx->time_base,
-                VideoStream->time_base
-            );
+    UE_LOG(LogFFmpegEncodeThread, Log, TEXT("Audio track [%s]: %dHz %dch -> %dHz %dch %S"),
+        *Track.Name, InSampleRate, InNumChannels, Ctx->sample_rate, Ctx->ch_layout.nb_channels, av_get_sample_fmt_name(Ctx->sample_fmt));
 
-            Packet->stream_index = VideoStream->index;
-            av_interleaved_write_frame(FormatCtx, Packet);
-            av_packet_unref(Packet);
-        }
+    // 输入声道数以实际到达的数据为准，按标准布局映射到编码器声道
+    AVChannelLayout InLayout;
+    av_channel_layout_default(&InLayout, InNumChannels);
+
+    const int Ret = swr_alloc_set_opts2(
+        &Track.SwrCtx,
+        &Ctx->ch_layout,
+        Ctx->sample_fmt,
+        Ctx->sample_rate,
+        &InLayout,
+        AV_SAMPLE_FMT_FLT, // 不是AV_SAMPLE_FMT_S16
+        InSampleRate,
+        0,
+        nullptr
+    );
+    av_channel_layout_uninit(&InLayout);
+
+    if (Ret < 0 || swr_init(Track.SwrCtx) < 0)
+    {
+        UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Failed to init resampler for %d channels (%s)"), InNumChannels, *Track.Name);
+        swr_free(&Track.SwrCtx);
+        return false;
     }
 
-    // ================== Flush Audio ==================
-    if (AudioCodecCtx && AudioStream)
+    if (bResample)
     {
-        const int32 NumChannels = AudioCodecCtx->ch_layout.nb_channels;
-        const int32 FrameSamplesPerChannel = AudioCodecCtx->frame_size;
-        const int32 FrameSamplesTotal = FrameSamplesPerChannel * NumChannels;
+        // 输出缓冲按一块输入最多产出的样本数分配，余量留给重采样器内部的延迟
+        Track.ResampleFrame = av_frame_alloc();
+        Track.Fifo = av_audio_fifo_alloc(Ctx->sample_fmt, Ctx->ch_layout.nb_channels, Track.FrameSize * 4);
+        if (Track.ResampleFrame)
+        {
+            Track.ResampleFrame->nb_samples = swr_get_out_samples(Track.SwrCtx, Track.FrameSize) + 256;
+            Track.ResampleFrame->format = Ctx->sample_fmt;
+            Track.ResampleFrame->sample_rate = Ctx->sample_rate;
+            av_channel_layout_copy(&Track.ResampleFrame->ch_layout, &Ctx->ch_layout);
+        }
 
-        // ① 先把 PendingAudioSamples 里剩余的 samples 补齐送进去
-        if (PendingAudioSamples.Num() > 0)
+        if (!Track.Fifo || !Track.ResampleFrame || av_frame_get_buffer(Track.ResampleFrame, 0) < 0)
         {
-            if (PendingAudioSamples.Num() < FrameSamplesTotal)
+            UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Failed to alloc resample buffers (%s)"), *Track.Name);
+            av_frame_free(&Track.ResampleFrame);
+            if (Track.Fifo)
             {
-                PendingAudioSamples.AddZeroed(
-                    FrameSamplesTotal - PendingAudioSamples.Num()
-                );
+                av_audio_fifo_free(Track.Fifo);
+                Track.Fifo = nullptr;
             }
+            swr_free(&Track.SwrCtx);
+            return false;
+        }
+    }
+
+    Track.InputChannels = InNumChannels;
+    return true;
+}
+
+void FLBRFFmpegEncodeThread::FlushVideoEncoder()
+{
+    if (!CodecCtx || !VideoPacket)
+        return;
+
+    avcodec_send_frame(CodecCtx, nullptr);
+    DrainEncoder(CodecCtx, VideoStreamIndex, VideoPacket);
+}
 
-            FLBRAudioFrame LastFrame;
-            LastFrame.NumChannels = NumChannels;
-            LastFrame.Samples = MoveTemp(PendingAudioSamples);
+void FLBRFFmpegEncodeThread::FlushAudioEncoder()
+{
+    if (AudioTracks.Num() == 0 || !AudioTracks[0]->CodecCtx)
+        return;
 
-            EncodeOneAudioFrame(LastFrame);
+    // ① 各源轨把环里剩余的 samples 编完，补齐到同一个块边界，混音轨随之编完
+    AlignAudioTrackStarts();
+    if (bAudioClockBaseSet)
+    {
+        for (int32 i = 0; i < NumSourceTracks; ++i)
+        {
+            ResampleIntoFifo(*AudioTracks[i], true);
         }
 
-        // ② 再真正 flush AAC encoder
-        avcodec_send_frame(AudioCodecCtx, nullptr);
+        const int32 FrameSize = AudioTracks[0]->FrameSize;
+        int64 EndPTS = 0;
+        for (int32 i = 0; i < NumSourceTracks; ++i)
+        {
+            const FAudioTrack& Track = *AudioTracks[i];
+            EndPTS = FMath::Max(EndPTS, Track.NextPTS + Track.PendingSilence + GetReadableFrames(Track));
+        }
+        EndPTS = FMath::DivideAndRoundUp<int64>(EndPTS, FrameSize) * FrameSize;
 
-        while (avcodec_receive_packet(AudioCodecCtx, Packet) == 0)
+        for (;;)
         {
-            av_packet_rescale_ts(
-                Packet,
-                AudioCodecCtx->time_base,
-                AudioStream->time_base
-            );
+            FAudioTrack* Lagging = nullptr;
+            for (int32 i = 0; i < NumSourceTracks; ++i)
+            {
+                FAudioTrack& Track = *AudioTracks[i];
+                if (Track.NextPTS < EndPTS && (!Lagging || Track.NextPTS < Lagging->NextPTS))
+                {
+                    Lagging = &Track;
+                }
+            }
+            if (!Lagging)
+            {
+                break;
+            }
+            EncodeTrackBlock(*Lagging, true);
+            EncodeReadyDownmix();
+        }
+    }
 
-            Packet->stream_index = AudioStream->index;
-            av_interleaved_write_frame(FormatCtx, Packet);
-            av_packet_unref(Packet);
+    // ② 再真正 flush AAC encoder
+    for (TUniquePtr<FAudioTrack>& Track : AudioTracks)
+    {
+        if (Track->CodecCtx && Track->Packet)
+        {
+            avcodec_send_frame(Track->CodecCtx, nullptr);
+            DrainEncoder(Track->CodecCtx, Track->StreamIndex, Track->Packet);
         }
     }
 }
@@ -469,6 +2068,21 @@ void FLBRFFmpegEncodeThread::FlushEncoder()
 
 void FLBRFFmpegEncodeThread::Cleanup()
 {
+    for (AVFrame*& Frame : VideoFrameRing)
+    {
+        av_frame_free(&Frame);
+    }
+    VideoFrameRing.Empty();
+
+    for (TUniquePtr<FAudioTrack>& Track : AudioTracks)
+    {
+        for (AVFrame*& Frame : Track->FrameRing)
+        {
+            av_frame_free(&Frame);
+        }
+        Track->FrameRing.Empty();
+    }
+
     if (SwsCtx)
     {
         sws_freeContext(SwsCtx);
@@ -481,37 +2095,38 @@ void FLBRFFmpegEncodeThread::Cleanup()
         CodecCtx = nullptr;
     }
 
-    if (FormatCtx)
-    {
-        if (!(FormatCtx->oformat->flags & AVFMT_NOFILE))
-        {
-            avio_closep(&FormatCtx->pb);
-        }
-
-        avformat_free_context(FormatCtx);
-        FormatCtx = nullptr;
-    }
+    // 正常结束时两段都已在 Run 中收尾，这里只处理初始化失败的情况
+    CloseSegmentFile(ClosingSegment.FormatCtx, ClosingSegment.Writer);
+    CloseSegmentFile(Segment.FormatCtx, Segment.Writer);
 
-    if (Packet)
+    if (VideoPacket)
     {
-        av_packet_free(&Packet);
-        Packet = nullptr;
+        av_packet_free(&VideoPacket);
     }
 
-    if (FrameEvent)
+    for (TUniquePtr<FAudioTrack>& Track : AudioTracks)
     {
-        FPlatformProcess::ReturnSynchEventToPool(FrameEvent);
-        FrameEvent = nullptr;
-    }
+        if (Track->Packet)
+        {
+            av_packet_free(&Track->Packet);
+        }
 
-    if (SwrCtx)
-    {
-        swr_free(&SwrCtx);
-    }
+        if (Track->SwrCtx)
+        {
+            swr_free(&Track->SwrCtx);
+        }
 
-    if (AudioCodecCtx)
-    {
-        av_channel_layout_uninit(&AudioCodecCtx->ch_layout);
-        avcodec_free_context(&AudioCodecCtx);
+        if (Track->Fifo)
+        {
+            av_audio_fifo_free(Track->Fifo);
+            Track->Fifo = nullptr;
+        }
+        av_frame_free(&Track->ResampleFrame);
+
+        if (Track->CodecCtx)
+        {
+            av_channel_layout_uninit(&Track->CodecCtx->ch_layout);
+            avcodec_free_context(&Track->CodecCtx);
+        }
     }
 }
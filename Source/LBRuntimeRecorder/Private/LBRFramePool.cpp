@@ -0,0 +1,148 @@
+#include "LBRFramePool.h"
+#include "Misc/ScopeLock.h"
+
+uint32 FLBRPixelBuffer::Release() const
+{
+	const int32 Refs = NumRefs.Decrement();
+	if (Refs == 0)
+	{
+		FLBRPixelBuffer* MutableThis = const_cast<FLBRPixelBuffer*>(this);
+		TSharedPtr<FLBRFramePool, ESPMode::ThreadSafe> Pool = MoveTemp(MutableThis->OwnerPool);
+		if (Pool.IsValid())
+		{
+			Pool->Recycle(MutableThis);
+		}
+		else
+		{
+			delete this;
+		}
+	}
+	return uint32(Refs);
+}
+
+FLBRFramePool::FLBRFramePool(int32 InMaxPooledPerSize)
+	: MaxPooledPerSize(FMath::Max(1, InMaxPooledPerSize))
+{
+}
+
+FLBRFramePool::~FLBRFramePool()
+{
+	// 借出的缓冲持有池的引用，走到这里说明全部已归还
+	Trim();
+}
+
+FLBRPixelBufferRef FLBRFramePool::Acquire(int32 NumPixels)
+{
+	FLBRPixelBuffer* Buffer = nullptr;
+	{
+		FScopeLock Lock(&Mutex);
+
+		TArray<FLBRPixelBuffer*>* FreeList = FreeLists.Find(NumPixels);
+		if (FreeList && FreeList->Num() > 0)
+		{
+			Buffer = FreeList->Pop(EAllowShrinking::No);
+			Stats.Hits++;
+			Stats.Pooled--;
+		}
+		else
+		{
+			Stats.Misses++;
+		}
+
+		Stats.InUse++;
+		Stats.HighWaterInUse = FMath::Max(Stats.HighWaterInUse, Stats.InUse);
+	}
+
+	if (!Buffer)
+	{
+		// 在锁外分配，避免大块 malloc 阻塞其他线程
+		Buffer = new FLBRPixelBuffer();
+		Buffer->Pixels.SetNumUninitialized(NumPixels);
+	}
+
+	Buffer->OwnerPool = AsShared();
+	return FLBRPixelBufferRef(Buffer);
+}
+
+void FLBRFramePool::Recycle(FLBRPixelBuffer* Buffer)
+{
+	const int32 NumPixels = Buffer->Pixels.Num();
+	bool bKeep = false;
+	{
+		FScopeLock Lock(&Mutex);
+
+		Stats.InUse--;
+
+		TArray<FLBRPixelBuffer*>& FreeList = FreeLists.FindOrAdd(NumPixels);
+		if (FreeList.Num() < MaxPooledPerSize)
+		{
+			FreeList.Add(Buffer);
+			Stats.Pooled++;
+			bKeep = true;
+		}
+	}
+
+	if (!bKeep)
+	{
+		delete Buffer;
+	}
+}
+
+void FLBRFramePool::Prewarm(int32 NumPixels, int32 Count)
+{
+	int32 ToAllocate = 0;
+	{
+		FScopeLock Lock(&Mutex);
+		const TArray<FLBRPixelBuffer*>* FreeList = FreeLists.Find(NumPixels);
+		ToAllocate = FMath::Min(Count, MaxPooledPerSize) - (FreeList ? FreeList->Num() : 0);
+	}
+
+	// 同 Acquire，在锁外分配
+	TArray<FLBRPixelBuffer*> Buffers;
+	for (int32 i = 0; i < ToAllocate; ++i)
+	{
+		FLBRPixelBuffer* Buffer = new FLBRPixelBuffer();
+		Buffer->Pixels.SetNumUninitialized(NumPixels);
+		Buffers.Add(Buffer);
+	}
+
+	{
+		FScopeLock Lock(&Mutex);
+		TArray<FLBRPixelBuffer*>& FreeList = FreeLists.FindOrAdd(NumPixels);
+		while (Buffers.Num() > 0 && FreeList.Num() < MaxPooledPerSize)
+		{
+			FreeList.Add(Buffers.Pop(EAllowShrinking::No));
+			Stats.Pooled++;
+		}
+	}
+
+	for (FLBRPixelBuffer* Buffer : Buffers)
+	{
+		delete Buffer;
+	}
+}
+
+FLBRFramePoolStats FLBRFramePool::GetStats() const
+{
+	FScopeLock Lock(&Mutex);
+	return Stats;
+}
+
+void FLBRFramePool::Trim()
+{
+	TMap<int32, TArray<FLBRPixelBuffer*>> ToDelete;
+	{
+		FScopeLock Lock(&Mutex);
+		ToDelete = MoveTemp(FreeLists);
+		FreeLists.Reset();
+		Stats.Pooled = 0;
+	}
+
+	for (TPair<int32, TArray<FLBRPixelBuffer*>>& Pair : ToDelete)
+	{
+		for (FLBRPixelBuffer* Buffer : Pair.Value)
+		{
+			delete Buffer;
+		}
+	}
+}
@@ -0,0 +1,61 @@
+#include "LBRKeyframeIndex.h"
+#include "Algo/BinarySearch.h"
+#include "Misc/FileHelper.h"
+
+static const ANSICHAR KeyframeIndexMagic[8] = { 'L', 'B', 'R', 'K', 'I', 'D', 'X', '1' };
+
+FString FLBRKeyframeIndex::GetSidecarPath(const FString& MediaFile)
+{
+	return MediaFile + TEXT(".kidx");
+}
+
+bool FLBRKeyframeIndex::Save(const FString& MediaFile) const
+{
+	TArray<uint8> Bytes;
+	Bytes.Reserve(sizeof(KeyframeIndexMagic) + Entries.Num() * 2 * sizeof(int64));
+	Bytes.Append(reinterpret_cast<const uint8*>(KeyframeIndexMagic), sizeof(KeyframeIndexMagic));
+
+	for (const FLBRKeyframeIndexEntry& Entry : Entries)
+	{
+		int64 Fields[2] = { Entry.TimeUs, Entry.ByteOffset };
+		Bytes.Append(reinterpret_cast<const uint8*>(Fields), sizeof(Fields));
+	}
+
+	return FFileHelper::SaveArrayToFile(Bytes, *GetSidecarPath(MediaFile));
+}
+
+bool FLBRKeyframeIndex::Load(const FString& MediaFile)
+{
+	Entries.Reset();
+
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *GetSidecarPath(MediaFile), FILEREAD_Silent))
+	{
+		return false;
+	}
+
+	const int32 HeaderSize = int32(sizeof(KeyframeIndexMagic));
+	if (Bytes.Num() < HeaderSize || FMemory::Memcmp(Bytes.GetData(), KeyframeIndexMagic, HeaderSize) != 0)
+	{
+		return false;
+	}
+
+	// 末尾不完整的条目直接忽略
+	const int32 NumEntries = (Bytes.Num() - HeaderSize) / int32(2 * sizeof(int64));
+	Entries.SetNumUninitialized(NumEntries);
+	for (int32 i = 0; i < NumEntries; ++i)
+	{
+		int64 Fields[2];
+		FMemory::Memcpy(Fields, Bytes.GetData() + HeaderSize + i * sizeof(Fields), sizeof(Fields));
+		Entries[i].TimeUs = Fields[0];
+		Entries[i].ByteOffset = Fields[1];
+	}
+	return true;
+}
+
+const FLBRKeyframeIndexEntry* FLBRKeyframeIndex::FindAtOrBefore(int64 TimeUs) const
+{
+	// 条目按写入顺序时间递增
+	const int32 Index = Algo::UpperBoundBy(Entries, TimeUs, &FLBRKeyframeIndexEntry::TimeUs) - 1;
+	return Entries.IsValidIndex(Index) ? &Entries[Index] : nullptr;
+}
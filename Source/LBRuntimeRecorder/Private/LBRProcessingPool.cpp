@@ -0,0 +1,169 @@
+#include "LBRProcessingPool.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/ScopeLock.h"
+
+DEFINE_LOG_CATEGORY(LogLBRProcessingPool);
+
+FLBRProcessingPool::FLBRProcessingPool(int32 InNumWorkers, int32 InQueueCapacity, const TCHAR* InName)
+	: Capacity(FMath::Max(1, InQueueCapacity))
+{
+	Queue.SetNum(Capacity);
+
+	WorkEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	SpaceEvent = FPlatformProcess::GetSynchEventFromPool(false);
+
+	const int32 NumWorkers = FMath::Max(1, InNumWorkers);
+	for (int32 i = 0; i < NumWorkers; ++i)
+	{
+		FWorker* Worker = new FWorker(*this);
+		Workers.Add(Worker);
+		Threads.Add(FRunnableThread::Create(
+			Worker,
+			*FString::Printf(TEXT("%s_%d"), InName, i),
+			0,
+			TPri_Normal
+		));
+	}
+
+	UE_LOG(LogLBRProcessingPool, Log, TEXT("%s: %d workers, queue capacity %d"), InName, NumWorkers, Capacity);
+}
+
+FLBRProcessingPool::~FLBRProcessingPool()
+{
+	Shutdown();
+
+	if (WorkEvent)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(WorkEvent);
+		WorkEvent = nullptr;
+	}
+
+	if (SpaceEvent)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(SpaceEvent);
+		SpaceEvent = nullptr;
+	}
+}
+
+bool FLBRProcessingPool::Enqueue(TUniqueFunction<void()>&& Task, bool bWaitWhenFull)
+{
+	while (true)
+	{
+		{
+			FScopeLock Lock(&Mutex);
+
+			if (bStopping)
+			{
+				return false;
+			}
+
+			if (Count < Capacity)
+			{
+				Queue[(Head + Count) % Capacity] = MoveTemp(Task);
+				Count++;
+				PeakCount = FMath::Max(PeakCount, Count);
+				break;
+			}
+
+			if (!bWaitWhenFull)
+			{
+				Rejected.Increment();
+				return false;
+			}
+		}
+
+		SpaceEvent->Wait();
+	}
+
+	WorkEvent->Trigger();
+	return true;
+}
+
+bool FLBRProcessingPool::Dequeue(TUniqueFunction<void()>& OutTask)
+{
+	bool bMore = false;
+	{
+		FScopeLock Lock(&Mutex);
+		if (Count == 0)
+		{
+			return false;
+		}
+
+		OutTask = MoveTemp(Queue[Head]);
+		Head = (Head + 1) % Capacity;
+		Count--;
+		bMore = Count > 0;
+	}
+
+	SpaceEvent->Trigger();
+
+	// 自动重置事件可能合并多次 Trigger，还有任务就继续唤醒下一个线程
+	if (bMore)
+	{
+		WorkEvent->Trigger();
+	}
+	return true;
+}
+
+void FLBRProcessingPool::Shutdown()
+{
+	if (Threads.Num() == 0)
+	{
+		return;
+	}
+
+	bStopping = true;
+	WorkEvent->Trigger();
+	SpaceEvent->Trigger();
+
+	for (FRunnableThread* Thread : Threads)
+	{
+		Thread->WaitForCompletion();
+		delete Thread;
+	}
+	Threads.Empty();
+
+	for (FWorker* Worker : Workers)
+	{
+		delete Worker;
+	}
+	Workers.Empty();
+}
+
+int32 FLBRProcessingPool::GetQueueDepth() const
+{
+	FScopeLock Lock(&Mutex);
+	return Count;
+}
+
+int32 FLBRProcessingPool::GetPeakQueueDepth() const
+{
+	FScopeLock Lock(&Mutex);
+	return PeakCount;
+}
+
+uint32 FLBRProcessingPool::FWorker::Run()
+{
+	TUniqueFunction<void()> Task;
+	while (true)
+	{
+		if (Owner.Dequeue(Task))
+		{
+			Task();
+			Task = nullptr;
+			continue;
+		}
+
+		if (Owner.bStopping)
+		{
+			break;
+		}
+
+		Owner.WorkEvent->Wait();
+	}
+
+	// 把停止信号传给下一个还在等待的线程
+	Owner.WorkEvent->Trigger();
+	return 0;
+}
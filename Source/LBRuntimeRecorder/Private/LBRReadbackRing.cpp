@@ -0,0 +1,73 @@
+#include "LBRReadbackRing.h"
+#include "RHIGPUReadback.h"
+
+DEFINE_LOG_CATEGORY(LogLBRReadbackRing);
+
+FLBRReadbackRing::FLBRReadbackRing(int32 InNumSlots)
+	: NumSlots(FMath::Max(1, InNumSlots))
+{
+	Slots.SetNum(NumSlots);
+}
+
+FLBRReadbackRing::~FLBRReadbackRing()
+{
+	// 未收割的回调直接丢弃，不再触发
+	Slots.Empty();
+}
+
+bool FLBRReadbackRing::Enqueue(FRHICommandListImmediate& RHICmdList, FRHITexture* SourceTexture, FOnReadbackReady&& OnReady)
+{
+	check(IsInRenderingThread());
+
+	// 先把已完成的槽腾出来
+	Harvest();
+
+	if (NumInFlight.GetValue() >= NumSlots)
+	{
+		Dropped.Increment();
+		return false;
+	}
+
+	FSlot& Slot = Slots[(Head + NumInFlight.GetValue()) % NumSlots];
+	if (!Slot.Readback.IsValid())
+	{
+		Slot.Readback = MakeUnique<FRHIGPUTextureReadback>(TEXT("LBRReadbackRing"));
+	}
+
+	Slot.Readback->EnqueueCopy(RHICmdList, SourceTexture);
+	Slot.OnReady = MoveTemp(OnReady);
+	NumInFlight.Increment();
+	return true;
+}
+
+void FLBRReadbackRing::Harvest()
+{
+	check(IsInRenderingThread());
+
+	// 按提交顺序收割，遇到未完成的槽就停，保证帧序
+	while (NumInFlight.GetValue() > 0)
+	{
+		FSlot& Slot = Slots[Head];
+		if (!Slot.Readback->IsReady())
+		{
+			break;
+		}
+
+		int32 RowPitchInPixels = 0;
+		int32 Height = 0;
+		const void* Data = Slot.Readback->Lock(RowPitchInPixels, &Height);
+		if (Data)
+		{
+			Slot.OnReady(Data, RowPitchInPixels, Height);
+		}
+		else
+		{
+			UE_LOG(LogLBRReadbackRing, Error, TEXT("Failed to lock readback data"));
+		}
+		Slot.Readback->Unlock();
+
+		Slot.OnReady = nullptr;
+		Head = (Head + 1) % NumSlots;
+		NumInFlight.Decrement();
+	}
+}
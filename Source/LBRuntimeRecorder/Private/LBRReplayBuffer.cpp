@@ -0,0 +1,218 @@
+#include "LBRReplayBuffer.h"
+#include "Async/Async.h"
+
+FLBRReplayBuffer::FLBRReplayBuffer(double InMaxSeconds, int64 InMaxBytes)
+	: MaxSeconds(FMath::Max(1.0, InMaxSeconds))
+	, MaxBytes(FMath::Max<int64>(1024 * 1024, InMaxBytes))
+{
+}
+
+FLBRReplayBuffer::~FLBRReplayBuffer()
+{
+	for (FStreamInfo& Stream : Streams)
+	{
+		avcodec_parameters_free(&Stream.Params);
+	}
+}
+
+void FLBRReplayBuffer::AddStream(const AVCodecContext* Encoder)
+{
+	FStreamInfo& Stream = Streams.AddDefaulted_GetRef();
+	Stream.Params = avcodec_parameters_alloc();
+	avcodec_parameters_from_context(Stream.Params, Encoder);
+	Stream.TimeBase = Encoder->time_base;
+
+	if (VideoStreamIndex == INDEX_NONE && Encoder->codec_type == AVMEDIA_TYPE_VIDEO)
+	{
+		VideoStreamIndex = Streams.Num() - 1;
+	}
+}
+
+void FLBRReplayBuffer::Add(const AVPacket* Pkt)
+{
+	if (!Streams.IsValidIndex(Pkt->stream_index) || Pkt->pts == AV_NOPTS_VALUE)
+	{
+		return;
+	}
+
+	// 只增加数据缓冲的引用计数
+	FLBRAVPacketPtr Clone(av_packet_clone(Pkt));
+	if (!Clone)
+	{
+		return;
+	}
+
+	const double Time = Pkt->pts * av_q2d(Streams[Pkt->stream_index].TimeBase);
+	const bool bKeyframe = Pkt->stream_index == VideoStreamIndex && (Pkt->flags & AV_PKT_FLAG_KEY);
+
+	FScopeLock Lock(&Mutex);
+
+	if (bKeyframe)
+	{
+		Keyframes.EmplaceLast(FKeyframe{ Time, NextSerial });
+	}
+
+	Bytes += Clone->size;
+	NewestTime = FMath::Max(NewestTime, Time);
+	Entries.EmplaceLast(FEntry{ MoveTemp(Clone), Time, NextSerial++ });
+
+	Evict();
+}
+
+void FLBRReplayBuffer::Evict()
+{
+	// 第二个关键帧之后的内容已足够覆盖时长（或超出内存上限）时，整段丢弃最旧的 GOP，至少保留一个
+	while (Keyframes.Num() >= 2 && (NewestTime - Keyframes[1].Time >= MaxSeconds || Bytes > MaxBytes))
+	{
+		const int64 KeepFrom = Keyframes[1].Serial;
+		while (Entries.Num() > 0 && Entries.First().Serial < KeepFrom)
+		{
+			Bytes -= Entries.First().Packet->size;
+			Entries.PopFirst();
+			Evicted++;
+		}
+		Keyframes.PopFirst();
+	}
+}
+
+bool FLBRReplayBuffer::SaveAsync(const FString& FilePath, const char* MuxerName, double Seconds, FOnReplaySaved&& OnSaved)
+{
+	TArray<FLBRAVPacketPtr> Packets;
+	TArray<int64> Offsets;
+
+	{
+		FScopeLock Lock(&Mutex);
+
+		if (Keyframes.Num() == 0)
+		{
+			return false;
+		}
+
+		// 起点取不晚于 Newest - Seconds 的最后一个关键帧
+		const double WantedStart = NewestTime - FMath::Max(0.0, Seconds);
+		FKeyframe Start = Keyframes.First();
+		for (const FKeyframe& Keyframe : Keyframes)
+		{
+			if (Keyframe.Time > WantedStart)
+			{
+				break;
+			}
+			Start = Keyframe;
+		}
+
+		// 视频从关键帧开始；音频按时间取，mux 阶段两路包的到达顺序并不严格交错
+		Packets.Reserve(Entries.Num());
+		for (const FEntry& Entry : Entries)
+		{
+			const bool bVideo = Entry.Packet->stream_index == VideoStreamIndex;
+			if (bVideo ? Entry.Serial >= Start.Serial : Entry.Time >= Start.Time)
+			{
+				Packets.Emplace(av_packet_clone(Entry.Packet.Get()));
+			}
+		}
+
+		for (const FStreamInfo& Stream : Streams)
+		{
+			Offsets.Add(av_rescale_q(FMath::RoundToInt64(Start.Time * AV_TIME_BASE), AV_TIME_BASE_Q, Stream.TimeBase));
+		}
+	}
+
+	// 回调与写文件都只依赖快照和本对象持有的流参数
+	Async(EAsyncExecution::ThreadPool,
+		[Self = AsShared(), FilePath, MuxerName, Packets = MoveTemp(Packets), Offsets = MoveTemp(Offsets), OnSaved = MoveTemp(OnSaved)]() mutable
+		{
+			const bool bSuccess = WriteFile(FilePath, MuxerName, Self->Streams, Packets, Offsets);
+			if (OnSaved)
+			{
+				OnSaved(FilePath, bSuccess);
+			}
+		});
+	return true;
+}
+
+bool FLBRReplayBuffer::WriteFile(const FString& FilePath, const char* MuxerName, const TArray<FStreamInfo>& InStreams, TArray<FLBRAVPacketPtr>& Packets, const TArray<int64>& Offsets)
+{
+	AVFormatContext* Ctx = nullptr;
+	avformat_alloc_output_context2(&Ctx, nullptr, MuxerName, TCHAR_TO_UTF8(*FilePath));
+	if (!Ctx)
+	{
+		UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Replay: failed to create format context"));
+		return false;
+	}
+
+	for (const FStreamInfo& Info : InStreams)
+	{
+		AVStream* Stream = avformat_new_stream(Ctx, nullptr);
+		avcodec_parameters_copy(Stream->codecpar, Info.Params);
+		Stream->time_base = Info.TimeBase;
+	}
+
+	bool bSuccess = false;
+	if ((Ctx->oformat->flags & AVFMT_NOFILE) || avio_open(&Ctx->pb, TCHAR_TO_UTF8(*FilePath), AVIO_FLAG_WRITE) >= 0)
+	{
+		int Ret = avformat_write_header(Ctx, nullptr);
+		if (Ret >= 0)
+		{
+			for (FLBRAVPacketPtr& Pkt : Packets)
+			{
+				if (!Pkt)
+				{
+					continue;
+				}
+
+				const int32 Index = Pkt->stream_index;
+				Pkt->pts -= Offsets[Index];
+				if (Pkt->dts != AV_NOPTS_VALUE)
+				{
+					Pkt->dts -= Offsets[Index];
+				}
+				av_packet_rescale_ts(Pkt.Get(), InStreams[Index].TimeBase, Ctx->streams[Index]->time_base);
+
+				Ret = av_interleaved_write_frame(Ctx, Pkt.Get());
+				if (Ret < 0)
+				{
+					UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Replay: av_interleaved_write_frame failed: %d"), Ret);
+					break;
+				}
+			}
+
+			bSuccess = Ret >= 0 && av_write_trailer(Ctx) >= 0;
+		}
+		else
+		{
+			UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Replay: avformat_write_header failed: %d"), Ret);
+		}
+
+		if (!(Ctx->oformat->flags & AVFMT_NOFILE))
+		{
+			avio_closep(&Ctx->pb);
+		}
+	}
+	else
+	{
+		UE_LOG(LogFFmpegEncodeThread, Error, TEXT("Replay: failed to open %s"), *FilePath);
+	}
+
+	avformat_free_context(Ctx);
+
+	UE_LOG(LogFFmpegEncodeThread, Log, TEXT("Replay saved to %s (%d packets): %s"), *FilePath, Packets.Num(), bSuccess ? TEXT("OK") : TEXT("FAILED"));
+	return bSuccess;
+}
+
+double FLBRReplayBuffer::GetBufferedSeconds() const
+{
+	FScopeLock Lock(&Mutex);
+	return Keyframes.Num() > 0 ? NewestTime - Keyframes.First().Time : 0.0;
+}
+
+int64 FLBRReplayBuffer::GetBufferedBytes() const
+{
+	FScopeLock Lock(&Mutex);
+	return Bytes;
+}
+
+int64 FLBRReplayBuffer::GetEvictedPackets() const
+{
+	FScopeLock Lock(&Mutex);
+	return Evicted;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// 编译期选择 SIMD 实现；只依赖编译目标保证存在的指令集，不做运行时分发
+#if PLATFORM_ENABLE_VECTORINTRINSICS_NEON && PLATFORM_64BITS
+	#define LBR_SIMD_NEON 1
+#else
+	#define LBR_SIMD_NEON 0
+#endif
+
+#if !LBR_SIMD_NEON && PLATFORM_ENABLE_VECTORINTRINSICS && ((defined(PLATFORM_ALWAYS_HAS_SSE4_1) && PLATFORM_ALWAYS_HAS_SSE4_1) || defined(__SSE4_1__))
+	#define LBR_SIMD_SSE 1
+#else
+	#define LBR_SIMD_SSE 0
+#endif
+
+#if LBR_SIMD_NEON
+	#include <arm_neon.h>
+#endif
+
+#if LBR_SIMD_SSE
+	#include <smmintrin.h>
+	#include <tmmintrin.h>
+#endif
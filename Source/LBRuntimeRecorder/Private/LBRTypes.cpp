@@ -3,3 +3,60 @@
 
 #include "LBRTypes.h"
 
+FLBRVideoEncoderSettings FLBRVideoEncoderSettings::FromPreset(ELBRVideoEncoderPreset InPreset)
+{
+	FLBRVideoEncoderSettings Settings;
+
+	switch (InPreset)
+	{
+	case ELBRVideoEncoderPreset::LowCPU:
+		Settings.Preset = TEXT("superfast");
+		Settings.CRF = 26;
+		Settings.MaxBFrames = 0;
+		Settings.ThreadCount = 2;
+		break;
+
+	case ELBRVideoEncoderPreset::ArchiveQuality:
+		Settings.Preset = TEXT("slow");
+		Settings.CRF = 18;
+		Settings.MaxBFrames = 3;
+		break;
+
+	case ELBRVideoEncoderPreset::LowLatency:
+		Settings.Preset = TEXT("ultrafast");
+		Settings.Tune = TEXT("zerolatency");
+		Settings.RateControl = ELBRRateControlMode::Bitrate;
+		Settings.TargetBitrateKbps = 6000;
+		Settings.MaxBitrateKbps = 6000;
+		Settings.BufferSizeKbits = 3000;
+		Settings.MaxBFrames = 0;
+		Settings.bSliceThreads = true;
+		break;
+
+	case ELBRVideoEncoderPreset::Custom:
+	default:
+		break;
+	}
+
+	return Settings;
+}
+
+FString FLBROutputSettings::GetFileExtension() const
+{
+	switch (ContainerFormat)
+	{
+	case ELBRContainerFormat::Matroska:
+		return TEXT(".mkv");
+
+	case ELBRContainerFormat::MPEGTS:
+		return TEXT(".ts");
+
+	case ELBRContainerFormat::QuickTime:
+		return TEXT(".mov");
+
+	case ELBRContainerFormat::MP4:
+	case ELBRContainerFormat::FragmentedMP4:
+	default:
+		return TEXT(".mp4");
+	}
+}
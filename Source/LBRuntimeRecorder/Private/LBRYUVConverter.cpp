@@ -0,0 +1,311 @@
+#include "LBRYUVConverter.h"
+#include "LBRColorCorrection.h"
+#include "LBRSimd.h"
+#include "Async/ParallelFor.h"
+
+namespace
+{
+	// 列块宽度（偶数），两行 BGRA 共 2KB，查表后的临时数据留在 L1
+	constexpr int32 BlockPixels = 256;
+	// 每个并行任务处理的行对数
+	constexpr int32 RowPairsPerBand = 16;
+
+	// BT.601 limited range 定点系数（与 libyuv 的 ARGBToI420 相同）
+	FORCEINLINE uint8 RGBToY(int32 R, int32 G, int32 B)
+	{
+		return uint8(((66 * R + 129 * G + 25 * B + 128) >> 8) + 16);
+	}
+
+	// 参数为 2x2 块内的通道和（0~1020）
+	FORCEINLINE uint8 SumToU(int32 R, int32 G, int32 B)
+	{
+		return uint8(((-38 * R - 74 * G + 112 * B + 512) >> 10) + 128);
+	}
+
+	FORCEINLINE uint8 SumToV(int32 R, int32 G, int32 B)
+	{
+		return uint8(((112 * R - 94 * G - 18 * B + 512) >> 10) + 128);
+	}
+
+	// 转换一段两行像素，Count 为奇数时最后一列与自身组成色度块
+	void ConvertSpanScalar(const FColor* Row0, const FColor* Row1, int32 Count, uint8* Y0, uint8* Y1, uint8* U, uint8* V)
+	{
+		for (int32 X = 0; X < Count; X += 2)
+		{
+			const int32 X1 = FMath::Min(X + 1, Count - 1);
+			const FColor& P00 = Row0[X];
+			const FColor& P01 = Row0[X1];
+			const FColor& P10 = Row1[X];
+			const FColor& P11 = Row1[X1];
+
+			Y0[X] = RGBToY(P00.R, P00.G, P00.B);
+			Y0[X1] = RGBToY(P01.R, P01.G, P01.B);
+			Y1[X] = RGBToY(P10.R, P10.G, P10.B);
+			Y1[X1] = RGBToY(P11.R, P11.G, P11.B);
+
+			const int32 SumR = P00.R + P01.R + P10.R + P11.R;
+			const int32 SumG = P00.G + P01.G + P10.G + P11.G;
+			const int32 SumB = P00.B + P01.B + P10.B + P11.B;
+
+			U[X / 2] = SumToU(SumR, SumG, SumB);
+			V[X / 2] = SumToV(SumR, SumG, SumB);
+		}
+	}
+
+#if LBR_SIMD_SSE
+	// 两个 16bit 展开的像素对寄存器 -> 4 个像素的 Y（int32，未加 16）
+	FORCEINLINE __m128i LumaSSE(__m128i P01, __m128i P23, __m128i Coeff, __m128i Bias)
+	{
+		const __m128i Sum = _mm_hadd_epi32(_mm_madd_epi16(P01, Coeff), _mm_madd_epi16(P23, Coeff));
+		return _mm_srai_epi32(_mm_add_epi32(Sum, Bias), 8);
+	}
+
+	FORCEINLINE void StoreLumaSSE(uint8* Dst, __m128i Lo, __m128i Hi, __m128i Offset)
+	{
+		const __m128i Y16 = _mm_add_epi16(_mm_packs_epi32(Lo, Hi), Offset);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(Dst), _mm_packus_epi16(Y16, Y16));
+	}
+
+	// 两组 2x2 通道和 -> 4 个色度值写入 Dst
+	FORCEINLINE void StoreChromaSSE(uint8* Dst, __m128i Q01, __m128i Q23, __m128i Coeff, __m128i Bias, __m128i Offset)
+	{
+		__m128i C = _mm_hadd_epi32(_mm_madd_epi16(Q01, Coeff), _mm_madd_epi16(Q23, Coeff));
+		C = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(C, Bias), 10), Offset);
+		const __m128i C16 = _mm_packs_epi32(C, C);
+		const int32 Packed = _mm_cvtsi128_si32(_mm_packus_epi16(C16, C16));
+		FMemory::Memcpy(Dst, &Packed, sizeof(Packed));
+	}
+
+	// 一个 16bit 寄存器里的两个相邻像素求和，结果在低 64 位
+	FORCEINLINE __m128i PairSumSSE(__m128i P)
+	{
+		return _mm_add_epi16(P, _mm_srli_si128(P, 8));
+	}
+
+	// 每次 8 个像素，返回已处理的像素数
+	int32 ConvertSpanVector(const FColor* Row0, const FColor* Row1, int32 Count, uint8* Y0, uint8* Y1, uint8* U, uint8* V)
+	{
+		const __m128i Zero = _mm_setzero_si128();
+		const __m128i YCoeff = _mm_setr_epi16(25, 129, 66, 0, 25, 129, 66, 0);
+		const __m128i UCoeff = _mm_setr_epi16(112, -74, -38, 0, 112, -74, -38, 0);
+		const __m128i VCoeff = _mm_setr_epi16(-18, -94, 112, 0, -18, -94, 112, 0);
+		const __m128i YBias = _mm_set1_epi32(128);
+		const __m128i YOffset = _mm_set1_epi16(16);
+		const __m128i CBias = _mm_set1_epi32(512);
+		const __m128i COffset = _mm_set1_epi32(128);
+
+		const int32 NumVector = Count & ~7;
+		for (int32 X = 0; X < NumVector; X += 8)
+		{
+			const __m128i A0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Row0 + X));
+			const __m128i A1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Row0 + X + 4));
+			const __m128i B0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Row1 + X));
+			const __m128i B1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Row1 + X + 4));
+
+			// 每个寄存器两个像素的 BGRA（16bit）
+			const __m128i A01 = _mm_unpacklo_epi8(A0, Zero);
+			const __m128i A23 = _mm_unpackhi_epi8(A0, Zero);
+			const __m128i A45 = _mm_unpacklo_epi8(A1, Zero);
+			const __m128i A67 = _mm_unpackhi_epi8(A1, Zero);
+			const __m128i B01 = _mm_unpacklo_epi8(B0, Zero);
+			const __m128i B23 = _mm_unpackhi_epi8(B0, Zero);
+			const __m128i B45 = _mm_unpacklo_epi8(B1, Zero);
+			const __m128i B67 = _mm_unpackhi_epi8(B1, Zero);
+
+			StoreLumaSSE(Y0 + X, LumaSSE(A01, A23, YCoeff, YBias), LumaSSE(A45, A67, YCoeff, YBias), YOffset);
+			StoreLumaSSE(Y1 + X, LumaSSE(B01, B23, YCoeff, YBias), LumaSSE(B45, B67, YCoeff, YBias), YOffset);
+
+			// 先纵向再横向求 2x2 和
+			const __m128i Q01 = _mm_unpacklo_epi64(PairSumSSE(_mm_add_epi16(A01, B01)), PairSumSSE(_mm_add_epi16(A23, B23)));
+			const __m128i Q23 = _mm_unpacklo_epi64(PairSumSSE(_mm_add_epi16(A45, B45)), PairSumSSE(_mm_add_epi16(A67, B67)));
+
+			StoreChromaSSE(U + X / 2, Q01, Q23, UCoeff, CBias, COffset);
+			StoreChromaSSE(V + X / 2, Q01, Q23, VCoeff, CBias, COffset);
+		}
+		return NumVector;
+	}
+#elif LBR_SIMD_NEON
+	FORCEINLINE uint8x8_t LumaNEON(const uint8x8x4_t& P)
+	{
+		// vld4 解交织后 val[0..3] = B/G/R/A
+		uint16x8_t Sum = vmull_u8(P.val[2], vdup_n_u8(66));
+		Sum = vmlal_u8(Sum, P.val[1], vdup_n_u8(129));
+		Sum = vmlal_u8(Sum, P.val[0], vdup_n_u8(25));
+		Sum = vaddq_u16(Sum, vdupq_n_u16(128));
+		return vadd_u8(vshrn_n_u16(Sum, 8), vdup_n_u8(16));
+	}
+
+	FORCEINLINE void StoreChromaNEON(uint8* Dst, int32x4_t R, int32x4_t G, int32x4_t B, int32 CR, int32 CG, int32 CB)
+	{
+		int32x4_t C = vdupq_n_s32(512);
+		C = vmlaq_n_s32(C, R, CR);
+		C = vmlaq_n_s32(C, G, CG);
+		C = vmlaq_n_s32(C, B, CB);
+		C = vaddq_s32(vshrq_n_s32(C, 10), vdupq_n_s32(128));
+
+		const int16x4_t C16 = vmovn_s32(C);
+		const uint8x8_t C8 = vqmovun_s16(vcombine_s16(C16, C16));
+		const uint32 Packed = vget_lane_u32(vreinterpret_u32_u8(C8), 0);
+		FMemory::Memcpy(Dst, &Packed, sizeof(Packed));
+	}
+
+	int32 ConvertSpanVector(const FColor* Row0, const FColor* Row1, int32 Count, uint8* Y0, uint8* Y1, uint8* U, uint8* V)
+	{
+		const int32 NumVector = Count & ~7;
+		for (int32 X = 0; X < NumVector; X += 8)
+		{
+			const uint8x8x4_t A = vld4_u8(reinterpret_cast<const uint8*>(Row0 + X));
+			const uint8x8x4_t B = vld4_u8(reinterpret_cast<const uint8*>(Row1 + X));
+
+			vst1_u8(Y0 + X, LumaNEON(A));
+			vst1_u8(Y1 + X, LumaNEON(B));
+
+			// 纵向相加后横向成对相加，得到 4 个 2x2 块的通道和
+			const int32x4_t SumB = vreinterpretq_s32_u32(vpaddlq_u16(vaddl_u8(A.val[0], B.val[0])));
+			const int32x4_t SumG = vreinterpretq_s32_u32(vpaddlq_u16(vaddl_u8(A.val[1], B.val[1])));
+			const int32x4_t SumR = vreinterpretq_s32_u32(vpaddlq_u16(vaddl_u8(A.val[2], B.val[2])));
+
+			StoreChromaNEON(U + X / 2, SumR, SumG, SumB, -38, -74, 112);
+			StoreChromaNEON(V + X / 2, SumR, SumG, SumB, 112, -94, -18);
+		}
+		return NumVector;
+	}
+#else
+	int32 ConvertSpanVector(const FColor* Row0, const FColor* Row1, int32 Count, uint8* Y0, uint8* Y1, uint8* U, uint8* V)
+	{
+		return 0;
+	}
+#endif
+
+	void ConvertRowPair(const FColor* Row0, const FColor* Row1, int32 Width, const FLBRToneLUT* LUT, uint8* Y0, uint8* Y1, uint8* U, uint8* V)
+	{
+		FColor Block0[BlockPixels];
+		FColor Block1[BlockPixels];
+
+		for (int32 XBlock = 0; XBlock < Width; XBlock += BlockPixels)
+		{
+			const int32 Count = FMath::Min(BlockPixels, Width - XBlock);
+			const FColor* Src0 = Row0 + XBlock;
+			const FColor* Src1 = Row1 + XBlock;
+
+			if (LUT)
+			{
+				FMemory::Memcpy(Block0, Src0, Count * sizeof(FColor));
+				LUT->Apply(Block0, Count);
+
+				if (Row1 != Row0)
+				{
+					FMemory::Memcpy(Block1, Src1, Count * sizeof(FColor));
+					LUT->Apply(Block1, Count);
+					Src1 = Block1;
+				}
+				else
+				{
+					Src1 = Block0;
+				}
+				Src0 = Block0;
+			}
+
+			const int32 Done = ConvertSpanVector(Src0, Src1, Count, Y0 + XBlock, Y1 + XBlock, U + XBlock / 2, V + XBlock / 2);
+
+			const int32 X = XBlock + Done;
+			ConvertSpanScalar(Src0 + Done, Src1 + Done, Count - Done, Y0 + X, Y1 + X, U + X / 2, V + X / 2);
+		}
+	}
+}
+
+void FLBRYUVConverter::Convert(const FColor* Src, int32 SrcStride, int32 Width, int32 Height, const FLBRToneLUT* LUT, const FLBRYUV420Planes& Dst, bool bParallel)
+{
+	if (!Src || Width <= 0 || Height <= 0)
+	{
+		return;
+	}
+
+	if (LUT && LUT->bIdentity)
+	{
+		LUT = nullptr;
+	}
+
+	// 奇数高度时最后一行与自身组成行对
+	const int32 NumPairs = FMath::DivideAndRoundUp(Height, 2);
+	auto ConvertPairs = [Src, SrcStride, Width, Height, LUT, &Dst](int32 FirstPair, int32 EndPair)
+		{
+			for (int32 Pair = FirstPair; Pair < EndPair; ++Pair)
+			{
+				const int32 Row = Pair * 2;
+				const bool bHasRow1 = Row + 1 < Height;
+
+				const FColor* Row0 = Src + int64(Row) * SrcStride;
+				const FColor* Row1 = bHasRow1 ? Row0 + SrcStride : Row0;
+				uint8* Y0 = Dst.Y + int64(Row) * Dst.YStride;
+				uint8* Y1 = bHasRow1 ? Y0 + Dst.YStride : Y0;
+
+				ConvertRowPair(Row0, Row1, Width, LUT, Y0, Y1, Dst.U + int64(Pair) * Dst.UStride, Dst.V + int64(Pair) * Dst.VStride);
+			}
+		};
+
+	if (!bParallel)
+	{
+		ConvertPairs(0, NumPairs);
+		return;
+	}
+
+	const int32 NumBands = FMath::DivideAndRoundUp(NumPairs, RowPairsPerBand);
+	ParallelFor(NumBands, [&ConvertPairs, NumPairs](int32 Band)
+		{
+			const int32 FirstPair = Band * RowPairsPerBand;
+			ConvertPairs(FirstPair, FMath::Min(FirstPair + RowPairsPerBand, NumPairs));
+		});
+}
+
+void FLBRYUVConverter::ConvertReference(const FColor* Src, int32 SrcStride, int32 Width, int32 Height, const FLBRToneLUT* LUT, const FLBRYUV420Planes& Dst)
+{
+	if (!Src || Width <= 0 || Height <= 0)
+	{
+		return;
+	}
+
+	auto Fetch = [Src, SrcStride, LUT](int32 X, int32 Y) -> FColor
+		{
+			FColor Pixel = Src[int64(Y) * SrcStride + X];
+			if (LUT)
+			{
+				Pixel.B = LUT->Table[Pixel.B];
+				Pixel.G = LUT->Table[Pixel.G];
+				Pixel.R = LUT->Table[Pixel.R];
+			}
+			return Pixel;
+		};
+
+	for (int32 Y = 0; Y < Height; ++Y)
+	{
+		for (int32 X = 0; X < Width; ++X)
+		{
+			const FColor Pixel = Fetch(X, Y);
+			Dst.Y[int64(Y) * Dst.YStride + X] = RGBToY(Pixel.R, Pixel.G, Pixel.B);
+		}
+	}
+
+	for (int32 CY = 0; CY < (Height + 1) / 2; ++CY)
+	{
+		for (int32 CX = 0; CX < (Width + 1) / 2; ++CX)
+		{
+			int32 SumR = 0;
+			int32 SumG = 0;
+			int32 SumB = 0;
+			for (int32 DY = 0; DY < 2; ++DY)
+			{
+				for (int32 DX = 0; DX < 2; ++DX)
+				{
+					const FColor Pixel = Fetch(FMath::Min(CX * 2 + DX, Width - 1), FMath::Min(CY * 2 + DY, Height - 1));
+					SumR += Pixel.R;
+					SumG += Pixel.G;
+					SumB += Pixel.B;
+				}
+			}
+
+			Dst.U[int64(CY) * Dst.UStride + CX] = SumToU(SumR, SumG, SumB);
+			Dst.V[int64(CY) * Dst.VStride + CX] = SumToV(SumR, SumG, SumB);
+		}
+	}
+}
@@ -6,6 +6,10 @@
 #include "RenderGraphBuilder.h"
 #include "RHIGPUReadback.h"
 #include "RenderGraphUtils.h"
+#include "Hash/xxhash.h"
+#include "LBRClipExtractor.h"
+#include "LBREncodeScheduler.h"
+#include "LBREncodeSchedulerSubsystem.h"
 #include <ImageUtils.h>
 
 DEFINE_LOG_CATEGORY(LogLBRuntimeVideoRecorder);
@@ -82,93 +86,193 @@ void ALBRuntimeVideoRecorderActor::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
+	// 每帧收割一次已完成的回读（截图不录制时也需要）
+	HarvestReadbacks();
+
 	if (!bIsRecording) return;
 
 	if (!RenderTarget) return;
 
 	TimeAccumulator += DeltaTime;
 
-	while (TimeAccumulator >= FrameInterval)
-	{
-		CaptureFrameAsync();
+	if (TimeAccumulator < FrameInterval) return;
 
-		TimeAccumulator -= FrameInterval;
-	}
+	// 到期才渲染一次；卡顿时积压的多个帧间隔合并为一次捕获，由 PTS 跳跃表示持续时间
+	const int32 DueFrames = FMath::FloorToInt(TimeAccumulator / FrameInterval);
+	TimeAccumulator -= DueFrames * FrameInterval;
+
+	CaptureComponent->CaptureScene();
+	CaptureFrameAsync(DueFrames - 1);
 }
 
 void ALBRuntimeVideoRecorderActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
 	Super::EndPlay(EndPlayReason);
 	StopRecording();
+	DisarmRecorder();
+
+	ReleaseProcessingPool();
+	ReleaseReadbackRing();
+}
+
+void ALBRuntimeVideoRecorderActor::ArmRecorder()
+{
+	if (bIsRecording || bIsArmed) return;
+
+	// 线程数或队列长度改过则重建后处理线程池
+	if (ProcessingPool.IsValid() &&
+		(ProcessingPool->GetNumWorkers() != ProcessingWorkerCount || ProcessingPool->GetQueueCapacity() != ProcessingQueueCapacity))
+	{
+		ReleaseProcessingPool();
+	}
+	EnsureProcessingPool();
+	EnsureReadbackRing();
+
+	// 稳定录制时同时借出的缓冲数就是池的上限，在后台先分配好
+	EnsureFramePool();
+	Async(EAsyncExecution::ThreadPool, [Pool = FramePool, NumPixels = CurrentWidth * CurrentHeight, Count = GetFramePoolCapacity()]()
+		{
+			Pool->Prewarm(NumPixels, Count);
+		});
+
+	// 正式文件名开始录制时才知道，先写到录像目录下的临时文件；编码器 Init（打开编码器、建目录、写文件头）在后台执行
+	const FString TempFile = FPaths::Combine(GetVideoStoragePath(),
+		FString::Printf(TEXT("LBRArmed_%s%s"), *FGuid::NewGuid().ToString(), *OutputSettings.GetFileExtension()));
+	CreateEncodeSession(TempFile);
+	bIsArmed = true;
+
+	UE_LOG(LogLBRuntimeVideoRecorder, Log, TEXT("Recorder armed, temporary output %s"), *TempFile);
+}
+
+void ALBRuntimeVideoRecorderActor::DisarmRecorder()
+{
+	if (!bIsArmed) return;
+
+	bIsArmed = false;
+	if (!EncodeThread)
+		return;
+
+	EncodeThread->DiscardOutput();
+	ShutdownEncodeSession();
+	EncodeThread.Reset();
 }
 
 void ALBRuntimeVideoRecorderActor::StartRecording(const FString& FileName)
 {
 	if (bIsRecording) return;
 
-	bIsRecording = true;
 	FrameInterval = 1.f / CaptureFPS;
 
-	CaptureComponent->bCaptureEveryFrame = true;
-	CaptureComponent->bCaptureOnMovement = true;
+	// 录制时由 Tick 按帧率调用 CaptureScene，不再每个游戏帧都渲染一遍场景
+	CaptureComponent->bCaptureEveryFrame = false;
+	CaptureComponent->bCaptureOnMovement = false;
+
+	// 目录由编码线程在打开文件时创建
+	if (bIsArmed && EncodeThread)
+	{
+		// 编码器已在后台就绪，只需给出正式路径，停止时临时文件改名过去
+		CurrentVideoFilePath = FPaths::Combine(GetVideoStoragePath(), FileName + EncodeThread->GetOutputSettings().GetFileExtension());
+		EncodeThread->CommitOutputFile(CurrentVideoFilePath);
+	}
+	else
+	{
+		// 线程数或队列长度改过则重建后处理线程池
+		if (ProcessingPool.IsValid() &&
+			(ProcessingPool->GetNumWorkers() != ProcessingWorkerCount || ProcessingPool->GetQueueCapacity() != ProcessingQueueCapacity))
+		{
+			ReleaseProcessingPool();
+		}
+		EnsureProcessingPool();
 
-	const FString SaveDir = GetVideoStoragePath();
-	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
-	if (!PlatformFile.DirectoryExists(*SaveDir))
+		CurrentVideoFilePath = FPaths::Combine(GetVideoStoragePath(), FileName + OutputSettings.GetFileExtension());
+		CreateEncodeSession(CurrentVideoFilePath);
+	}
+	bIsArmed = false;
+
+	// 开始录制音频：每条源轨订阅自己的 submix，同一设备、同一 submix 的录制器共用一个监听器
+	for (int32 Track = 0; Track < EncodeThread->GetNumSourceAudioTracks(); ++Track)
 	{
-		PlatformFile.CreateDirectoryTree(*SaveDir);
+		AudioCaptures.Add(LBSubmixCapture::Subscribe(EncodeThread->GetAudioRing(Track), SessionSubmixes[Track]));
 	}
 
-	CurrentVideoFilePath = FPaths::Combine(SaveDir, FileName + TEXT(".mp4"));
+	bIsRecording = true;
+	TimeAccumulator = 0.f;
+	FrameCounter = 0;
+	CaptureSequence = 0;
+	CoalescedFrames = 0;
 
+	UE_LOG(LogLBRuntimeVideoRecorder, Log, TEXT("Start recording at resolution %dx%d,Gamma[%.2f],Exposure[%.2f]."), CurrentWidth, CurrentHeight, Gamma, Exposure);
+}
 
-	EncodeThread = new FLBRFFmpegEncodeThread(
+void ALBRuntimeVideoRecorderActor::CreateEncodeSession(const FString& OutputFile)
+{
+	EncodeThread = MakeShared<FLBRFFmpegEncodeThread, ESPMode::ThreadSafe>(
 		CurrentWidth,
 		CurrentHeight,
 		CaptureFPS,
-		CurrentVideoFilePath
+		OutputFile,
+		EncodeQueueSettings,
+		VideoEncoderPreset == ELBRVideoEncoderPreset::Custom
+			? VideoEncoderSettings
+			: FLBRVideoEncoderSettings::FromPreset(VideoEncoderPreset),
+		OutputSettings,
+		AudioSettings
 	);
 
-	EncodeRunnable = FRunnableThread::Create(
-		EncodeThread,
-		TEXT("LBR_FFmpegEncodeThread"),
-		0,
-		TPri_AboveNormal
-	);
+	// 轨道数由编码器按同一份音频设置决定，submix 随会话一起记下
+	SessionSubmixes.Reset();
+	for (int32 Track = 0; Track < EncodeThread->GetNumSourceAudioTracks(); ++Track)
+	{
+		SessionSubmixes.Add(AudioSettings.Tracks.IsValidIndex(Track) ? AudioSettings.Tracks[Track].Submix : CaptureSubmix);
+	}
 
-	// 开始录制音频
-	AudioCapture = MakeShared<LBSubmixCapture>();
-	AudioCapture->OnAudioFrame.BindLambda(
-		[this](FLBRAudioFrame&& AudioFrame)
+	// 旧段在后台线程收尾，回到游戏线程再广播
+	EncodeThread->SetOnSegmentFinished([WeakThis = TWeakObjectPtr<ALBRuntimeVideoRecorderActor>(this)](const FString& FilePath, int32 SegmentIndex)
 		{
-			// 打印音频帧信息
-			float MaxSample = 0.f;
-			for (float s : AudioFrame.Samples)
-			{
-				MaxSample = FMath::Max(MaxSample, FMath::Abs(s));
-			}
+			AsyncTask(ENamedThreads::GameThread, [WeakThis, FilePath, SegmentIndex]()
+				{
+					if (ALBRuntimeVideoRecorderActor* Recorder = WeakThis.Get())
+					{
+						Recorder->OnSegmentFinished.Broadcast(FilePath, SegmentIndex);
+					}
+				});
+		});
 
-			UE_LOG(LogLBRuntimeVideoRecorder, Log,
-				TEXT("Audio frame PTS=%lld NumSamples=%d NumChannels=%d SampleRate=%d MaxSample=%f"),
-				AudioFrame.PTS,
-				AudioFrame.Samples.Num(),
-				AudioFrame.NumChannels,
-				AudioFrame.SampleRate,
-				MaxSample
-			);
+	ULBREncodeSchedulerSubsystem* SchedulerSubsystem = bUseSharedEncodeScheduler ? ULBREncodeSchedulerSubsystem::Get() : nullptr;
+	if (SchedulerSubsystem)
+	{
+		EncodeSchedulerSubsystem = SchedulerSubsystem;
+		SchedulerSubsystem->GetScheduler().AddSession(EncodeThread);
+	}
+	else
+	{
+		EncodeRunnable = FRunnableThread::Create(
+			EncodeThread.Get(),
+			TEXT("LBR_FFmpegEncodeThread"),
+			0,
+			TPri_AboveNormal
+		);
+	}
+}
 
-			if (EncodeThread)
-			{
-				EncodeThread->PushAudioFrame(MoveTemp(AudioFrame));
-			}
-		}
-	);
-	AudioCapture->Initialize();
+void ALBRuntimeVideoRecorderActor::ShutdownEncodeSession()
+{
+	// 通知线程停止（会 Flush）
+	EncodeThread->StopRecording();
 
-	bIsRecording = true;
-	TimeAccumulator = 0.f;
+	// 等待 Run() 或调度器上的会话完成
+	if (EncodeRunnable)
+	{
+		EncodeRunnable->WaitForCompletion();
 
-	UE_LOG(LogLBRuntimeVideoRecorder, Log, TEXT("Start recording at resolution %dx%d,Gamma[%.2f],Exposure[%.2f]."), CurrentWidth, CurrentHeight, Gamma, Exposure);
+		delete EncodeRunnable;
+		EncodeRunnable = nullptr;
+	}
+	else if (ULBREncodeSchedulerSubsystem* SchedulerSubsystem = EncodeSchedulerSubsystem.Get())
+	{
+		SchedulerSubsystem->GetScheduler().WaitForSession(EncodeThread.Get());
+	}
+	EncodeSchedulerSubsystem.Reset();
 }
 
 void ALBRuntimeVideoRecorderActor::StopRecording()
@@ -180,30 +284,87 @@ void ALBRuntimeVideoRecorderActor::StopRecording()
 	CaptureComponent->bCaptureEveryFrame = false;
 	CaptureComponent->bCaptureOnMovement = false;
 
-	if (!EncodeRunnable || !EncodeThread)
+	if (!EncodeThread)
 		return;
 
-	if (AudioCapture.IsValid())
+	for (int32 Track = 0; Track < AudioCaptures.Num(); ++Track)
 	{
-		AudioCapture->Uninitialize();
-		AudioCapture.Reset();
+		if (AudioCaptures[Track].IsValid())
+		{
+			LBSubmixCapture::Unsubscribe(AudioCaptures[Track], EncodeThread->GetAudioRing(Track));
+		}
 	}
+	AudioCaptures.Reset();
 
-	// 通知线程停止（会 Flush）
-	EncodeThread->StopRecording();
+	ShutdownEncodeSession();
 
-	// 等待 Run() 完成
-	EncodeRunnable->WaitForCompletion();
+	const FLBRBoundedQueueStats VideoQueueStats = EncodeThread->GetVideoQueueStats();
+	UE_LOG(LogLBRuntimeVideoRecorder, Log, TEXT("Captured %lld frames (%lld intervals coalesced), encode queue dropped %lld video frames."),
+		CaptureSequence, CoalescedFrames, VideoQueueStats.DroppedOldest + VideoQueueStats.DroppedNewest);
 
-	delete EncodeRunnable;
-	EncodeRunnable = nullptr;
+	// 仍在途的后处理任务可能还持有引用，推帧会被拒绝
+	EncodeThread.Reset();
 
-	delete EncodeThread;
-	EncodeThread = nullptr;
+	if (ReadbackRing.IsValid())
+	{
+		UE_LOG(LogLBRuntimeVideoRecorder, Log, TEXT("Readback ring: Slots=%d Dropped=%lld"),
+			ReadbackRing->GetNumSlots(), ReadbackRing->GetDroppedCount());
+	}
+
+	if (ProcessingPool.IsValid())
+	{
+		UE_LOG(LogLBRuntimeVideoRecorder, Log, TEXT("Processing pool: PeakDepth=%d Dropped=%lld"),
+			ProcessingPool->GetPeakQueueDepth(), ProcessingPool->GetRejectedCount());
+	}
+
+	if (FramePool.IsValid())
+	{
+		const FLBRFramePoolStats PoolStats = FramePool->GetStats();
+		UE_LOG(LogLBRuntimeVideoRecorder, Log, TEXT("Frame pool: Hits=%lld Misses=%lld HighWater=%d Pooled=%d"),
+			PoolStats.Hits, PoolStats.Misses, PoolStats.HighWaterInUse, PoolStats.Pooled);
+	}
 
 	UE_LOG(LogLBRuntimeVideoRecorder, Log, TEXT("Stop recording,video saved in %s."), *CurrentVideoFilePath);
 }
 
+bool ALBRuntimeVideoRecorderActor::SaveReplay(const FString& FileName, float Seconds)
+{
+	if (!bIsRecording || !EncodeThread.IsValid())
+	{
+		return false;
+	}
+
+	const FString FilePath = FPaths::Combine(GetVideoStoragePath(), FileName + EncodeThread->GetOutputSettings().GetFileExtension());
+	return EncodeThread->SaveReplay(FilePath, Seconds,
+		[WeakThis = TWeakObjectPtr<ALBRuntimeVideoRecorderActor>(this)](const FString& SavedPath, bool bSuccess)
+		{
+			AsyncTask(ENamedThreads::GameThread, [WeakThis, SavedPath, bSuccess]()
+				{
+					if (ALBRuntimeVideoRecorderActor* Recorder = WeakThis.Get())
+					{
+						Recorder->OnReplaySaved.Broadcast(SavedPath, bSuccess);
+					}
+				});
+		});
+}
+
+void ALBRuntimeVideoRecorderActor::ExtractClip(const FString& SourceFile, float StartSeconds, float EndSeconds, const FString& FileName)
+{
+	// 流拷贝不能换封装格式里不支持的编码，沿用源文件的扩展名
+	const FString FilePath = FPaths::Combine(GetVideoStoragePath(), FileName + FPaths::GetExtension(SourceFile, true));
+	FLBRClipExtractor::ExtractClipAsync(SourceFile, StartSeconds, EndSeconds, FilePath,
+		[WeakThis = TWeakObjectPtr<ALBRuntimeVideoRecorderActor>(this)](const FString& ClipPath, bool bSuccess)
+		{
+			AsyncTask(ENamedThreads::GameThread, [WeakThis, ClipPath, bSuccess]()
+				{
+					if (ALBRuntimeVideoRecorderActor* Recorder = WeakThis.Get())
+					{
+						Recorder->OnClipExtracted.Broadcast(ClipPath, bSuccess);
+					}
+				});
+		});
+}
+
 void ALBRuntimeVideoRecorderActor::SceneShot(const FString& FileName)
 {
 	// 如果没有开启录制，则临时开启捕捉
@@ -253,6 +414,33 @@ void ALBRuntimeVideoRecorderActor::SceneShot(const FString& FileName)
 
 // 如果需要优化，可以使用成员变量保存定时器句柄
 
+int32 ALBRuntimeVideoRecorderActor::GetProcessingQueueDepth() const
+{
+	return ProcessingPool.IsValid() ? ProcessingPool->GetQueueDepth() : 0;
+}
+
+TArray<FLBRAudioChannelLevel> ALBRuntimeVideoRecorderActor::GetAudioLevels(int32 Track) const
+{
+	TArray<FLBRAudioChannelLevel> Levels;
+	if (!EncodeThread.IsValid() || Track < 0 || Track >= EncodeThread->GetNumSourceAudioTracks())
+	{
+		return Levels;
+	}
+
+	const FLBRAudioMeter& Meter = EncodeThread->GetAudioMeter(Track);
+	const int32 NumChannels = Meter.GetNumChannels();
+	Levels.SetNum(NumChannels);
+	for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+	{
+		FLBRAudioChannelLevel& Level = Levels[Channel];
+		Level.Peak = Meter.GetPeak(Channel);
+		Level.RMS = Meter.GetRMS(Channel);
+		Level.PeakDb = Level.Peak > 1e-5f ? 20.f * FMath::LogX(10.f, Level.Peak) : -100.f;
+		Level.RMSDb = Level.RMS > 1e-5f ? 20.f * FMath::LogX(10.f, Level.RMS) : -100.f;
+	}
+	return Levels;
+}
+
 FString ALBRuntimeVideoRecorderActor::GetDateString(FString Format)
 {
 	return FDateTime::Now().ToString(*Format);
@@ -314,75 +502,142 @@ void ALBRuntimeVideoRecorderActor::InitRenderTarget()
 	}
 }
 
-void ALBRuntimeVideoRecorderActor::CaptureFrameAsync()
+FLBRToneLUTPtr ALBRuntimeVideoRecorderActor::GetToneLUT()
+{
+	if (!ToneLUT.IsValid() || !ToneLUT->Matches(Gamma, Exposure))
+	{
+		TSharedPtr<FLBRToneLUT, ESPMode::ThreadSafe> NewLUT = MakeShared<FLBRToneLUT, ESPMode::ThreadSafe>();
+		NewLUT->Build(Gamma, Exposure);
+		ToneLUT = NewLUT;
+	}
+	return ToneLUT;
+}
+
+void ALBRuntimeVideoRecorderActor::EnsureProcessingPool()
 {
+	if (!ProcessingPool.IsValid())
+	{
+		ProcessingPool = MakeShared<FLBRProcessingPool, ESPMode::ThreadSafe>(
+			ProcessingWorkerCount,
+			ProcessingQueueCapacity,
+			TEXT("LBR_Processing"));
+	}
+}
+
+void ALBRuntimeVideoRecorderActor::ReleaseProcessingPool()
+{
+	if (!ProcessingPool.IsValid())
+	{
+		return;
+	}
+
+	// 在游戏线程上等线程退出；渲染线程的回读回调只持有弱引用，之后拿到的也是已停止的池
+	ProcessingPool->Shutdown();
+	ProcessingPool.Reset();
+}
+
+void ALBRuntimeVideoRecorderActor::CaptureFrameAsync(int32 RepeatCount)
+{
+	// 发起捕获时就确定帧号和时间，后续各阶段乱序完成也不影响
+	const int64 FramePTS = FrameCounter;
+	const int64 Sequence = CaptureSequence++;
+	FrameCounter += 1 + RepeatCount;
+	CoalescedFrames += RepeatCount;
+	const double CaptureTime = FPlatformTime::Seconds();
+	const bool bNotify = OnFrameQueued.IsBound();
+
+	// 视频帧的调色交给编码线程，与 YUV 转换合并成一遍
+	// 回调在后处理线程上执行，直接推入编码队列，不再回到游戏线程
 	CaptureAsync(
 		RenderTarget,
-		Gamma,
-		Exposure,
-		[this](const TArray<FColor>& Pixels, int32 Width, int32 Height)
+		nullptr,
+		[Encoder = EncodeThread, WeakThis = TWeakObjectPtr<ALBRuntimeVideoRecorderActor>(this), FrameToneLUT = GetToneLUT(), FramePTS, Sequence, CaptureTime, bNotify]
+		(FLBRPixelBufferRef Buffer, int32 Width, int32 Height)
 		{
+			if (!Encoder.IsValid())
+				return;
+
 			FLBRRawFrame Frame;
+			Frame.ToneLUT = FrameToneLUT;
 			Frame.Width = Width;
 			Frame.Height = Height;
-			Frame.PTS = FrameCounter++;
-			Frame.Pixels = Pixels; // TArray<FColor> 拷贝
+			Frame.PTS = FramePTS;
+			Frame.Sequence = Sequence;
+			Frame.CaptureTime = CaptureTime;
+
+			// 在后处理线程上算哈希（XXH3，内部走 SIMD），编码阶段据此跳过重复帧
+			if (Encoder->GetVideoSettings().bSkipDuplicateFrames)
+			{
+				Frame.PixelHash = FXxHash64::HashBuffer(Buffer->Pixels.GetData(), Buffer->Pixels.Num() * sizeof(FColor)).Hash;
+			}
+			Frame.Buffer = MoveTemp(Buffer); // 只转移引用，不拷贝像素
 
+			// 丢帧由编码队列统计，停止录制时输出
+			const ELBRPushResult Result = Encoder->PushFrame(MoveTemp(Frame));
 
-			if (EncodeThread)
+			if (bNotify)
+			{
+				const bool bQueued = Result != ELBRPushResult::DroppedNewest && Result != ELBRPushResult::Rejected;
+				AsyncTask(ENamedThreads::GameThread, [WeakThis, FramePTS, bQueued]()
+					{
+						if (ALBRuntimeVideoRecorderActor* Recorder = WeakThis.Get())
+						{
+							Recorder->OnFrameQueued.Broadcast(FramePTS, bQueued);
+						}
+					});
+			}
+		},
+		// 入队前被丢弃的帧，通知编码器不必在重排窗口里等它
+		[Encoder = EncodeThread, Sequence]()
+		{
+			if (Encoder.IsValid())
 			{
-				UE_LOG(LogLBRuntimeVideoRecorder, Log, TEXT("Video frame PTS=%lld Width=%d Height=%d"), Frame.PTS, Frame.Width, Frame.Height);
-				EncodeThread->PushFrame(MoveTemp(Frame));
+				Encoder->ReportDroppedFrame(Sequence);
 			}
 		}
 	);
 }
 
-void ALBRuntimeVideoRecorderActor::CaptureAsync(UTextureRenderTarget2D* InRenderTarget, float InGamma, float InExposure, TFunction<void(const TArray<FColor>&, int32, int32)> Callback)
+void ALBRuntimeVideoRecorderActor::CaptureAsync(UTextureRenderTarget2D* InRenderTarget, FLBRToneLUTPtr InToneLUT, TFunction<void(FLBRPixelBufferRef, int32, int32)> OnProcessed, TFunction<void()> OnDropped)
 {
 	if (!InRenderTarget) return;
 
+	EnsureFramePool();
+	EnsureProcessingPool();
+	EnsureReadbackRing();
+
 	ENQUEUE_RENDER_COMMAND(LBR_LDR_Capture)(
-		[InRenderTarget, InGamma, InExposure, Callback](FRHICommandListImmediate& RHICmdList)
+		[InRenderTarget, InToneLUT, OnProcessed, OnDropped, Pool = FramePool, WeakProcessing = TWeakPtr<FLBRProcessingPool, ESPMode::ThreadSafe>(ProcessingPool), Ring = ReadbackRing](FRHICommandListImmediate& RHICmdList)
 		{
 			FTextureRenderTargetResource* RTResource =
 				InRenderTarget->GetRenderTargetResource();
 
-			if (!RTResource) return;
+			if (!RTResource)
+			{
+				if (OnDropped)
+				{
+					OnDropped();
+				}
+				return;
+			}
 
 
 			// 不使用RDG，直接使用RHI Readback（更简单稳定）
 			FRHITexture* SourceTexture = RTResource->GetTextureRHI();
 			FIntPoint TextureSize(RTResource->GetSizeX(), RTResource->GetSizeY());
 
-
-			// 创建Readback
-			TSharedPtr<FRHIGPUTextureReadback, ESPMode::ThreadSafe> Readback =
-				MakeShared<FRHIGPUTextureReadback, ESPMode::ThreadSafe>(TEXT("LDRReadback"));
-
-			// 发起异步拷贝
-			Readback->EnqueueCopy(RHICmdList, SourceTexture);
-
-			// ===== 轮询 Readback =====
-			auto Poll = [Readback, TextureSize, InGamma, InExposure, Callback](auto&& Self) -> void
+			// 拷贝到回读环的下一个空闲槽，完成后由每帧的 Harvest 回调（渲染线程，数据处于 Lock 状态）
+			const bool bEnqueued = Ring->Enqueue(RHICmdList, SourceTexture,
+				[TextureSize, InToneLUT, OnProcessed, OnDropped, Pool, WeakProcessing](const void* Data, int32 Width, int32 Height)
 				{
-					if (!Readback->IsReady())
-					{
-						// 短暂延迟后继续轮询
-						FPlatformProcess::Sleep(0.001f); // 1ms延迟
-						AsyncTask(ENamedThreads::ActualRenderingThread,
-							[Self]() { Self(Self); });
-						return;
-					}
-
-
-					int32 Width = 0, Height = 0;
-					void* Data = Readback->Lock(Width, &Height);
-
-					if (!Data)
+					// 线程池已在游戏线程上停止（EndPlay / 重建），丢弃这一帧
+					const TSharedPtr<FLBRProcessingPool, ESPMode::ThreadSafe> Processing = WeakProcessing.Pin();
+					if (!Processing.IsValid())
 					{
-						Readback->Unlock();
-						UE_LOG(LogLBRuntimeVideoRecorder, Error, TEXT("Failed to lock readback data"));
+						if (OnDropped)
+						{
+							OnDropped();
+						}
 						return;
 					}
 
@@ -393,75 +648,129 @@ void ALBRuntimeVideoRecorderActor::CaptureAsync(UTextureRenderTarget2D* InRender
 							TextureSize.X, TextureSize.Y, Width, Height);
 					}
 
-					TArray<FColor> Pixels;
 					const int32 TotalPixels = Width * Height;
-					Pixels.SetNumUninitialized(TotalPixels);
+					FLBRPixelBufferRef Buffer = Pool->Acquire(TotalPixels);
 
-					FMemory::Memcpy(Pixels.GetData(), Data, TotalPixels * sizeof(FColor));
-					Readback->Unlock();
+					FMemory::Memcpy(Buffer->Pixels.GetData(), Data, TotalPixels * sizeof(FColor));
 
 
 					// 调试输出
-					if (Pixels.Num() == 0)
+					if (Buffer->Pixels.Num() == 0)
 					{
 						UE_LOG(LogLBRuntimeVideoRecorder, Warning, TEXT("Readback empty Pixels."));
 					}
 
-					// 转到后台线程处理 Gamma/Exposure  (这里捕获Pixels是const,所以加mutable)
-					Async(EAsyncExecution::Thread, [Pixels = MoveTemp(Pixels), Width, Height, InGamma, InExposure, Callback]() mutable
+					// 交给后处理线程池处理 Gamma/Exposure（Gamma、Exposure 都为 1 时查表为恒等，直接跳过）
+					// 渲染线程不能等，队列满了直接丢弃这一帧
+					const bool bQueued = Processing->Enqueue([Buffer = MoveTemp(Buffer), Width, Height, InToneLUT, OnProcessed]() mutable
 						{
-							const float InvGamma = 1.0f / InGamma;
-							const float Exposure = InExposure;
-
-							for (FColor& Pixel : Pixels)
+							if (InToneLUT.IsValid())
 							{
-								float R = Pixel.R / 255.0f;
-								float G = Pixel.G / 255.0f;
-								float B = Pixel.B / 255.0f;
+								InToneLUT->ApplyParallel(Buffer->Pixels.GetData(), Width, Height);
+							}
 
-								R = FMath::Clamp(R * Exposure, 0.0f, 1.0f);
-								G = FMath::Clamp(G * Exposure, 0.0f, 1.0f);
-								B = FMath::Clamp(B * Exposure, 0.0f, 1.0f);
+							// 直接在后处理线程上回调
+							OnProcessed(MoveTemp(Buffer), Width, Height);
+						});
 
-								R = FMath::Pow(R, InvGamma);
-								G = FMath::Pow(G, InvGamma);
-								B = FMath::Pow(B, InvGamma);
+					// 被拒绝的次数由线程池计数，停止录制时输出
+					if (!bQueued)
+					{
+						if (OnDropped)
+						{
+							OnDropped();
+						}
+					}
+				});
 
-								Pixel.R = FMath::RoundToInt(R * 255);
-								Pixel.G = FMath::RoundToInt(G * 255);
-								Pixel.B = FMath::RoundToInt(B * 255);
-							}
+			// 回读环自己计数，停止录制时输出；渲染线程上不逐帧写日志
+			if (!bEnqueued)
+			{
+				if (OnDropped)
+				{
+					OnDropped();
+				}
+			}
+		});
+}
 
-							// 最后回调到游戏线程
-							AsyncTask(ENamedThreads::GameThread, [Pixels = MoveTemp(Pixels), Width, Height, Callback]()
-								{
-									Callback(Pixels, Width, Height);
-								});
-						});
-				};
+void ALBRuntimeVideoRecorderActor::HarvestReadbacks()
+{
+	if (!ReadbackRing.IsValid() || ReadbackRing->GetNumInFlight() == 0)
+	{
+		return;
+	}
 
-			AsyncTask(ENamedThreads::ActualRenderingThread,
-				[Poll]() { Poll(Poll); });
+	ENQUEUE_RENDER_COMMAND(LBR_HarvestReadbacks)(
+		[Ring = ReadbackRing](FRHICommandListImmediate& RHICmdList)
+		{
+			Ring->Harvest();
+		});
+}
+
+int32 ALBRuntimeVideoRecorderActor::GetFramePoolCapacity() const
+{
+	// 回读槽 + 后处理队列 + 编码队列 + 重排窗口各自可能占住一块，再加编码中的一块
+	return FMath::Max(1, ReadbackRingSize) + FMath::Max(0, ProcessingQueueCapacity)
+		+ FMath::Max(1, EncodeQueueSettings.MaxVideoFrames) + FMath::Max(1, EncodeQueueSettings.ReorderWindow) + 1;
+}
+
+void ALBRuntimeVideoRecorderActor::EnsureFramePool()
+{
+	// 上限改过则换新池，借出中的缓冲仍归还给各自的旧池
+	const int32 Capacity = GetFramePoolCapacity();
+	if (!FramePool.IsValid() || FramePool->GetMaxPooledPerSize() != Capacity)
+	{
+		FramePool = MakeShared<FLBRFramePool, ESPMode::ThreadSafe>(Capacity);
+	}
+}
+
+void ALBRuntimeVideoRecorderActor::EnsureReadbackRing()
+{
+	if (ReadbackRing.IsValid() && ReadbackRing->GetNumSlots() != ReadbackRingSize)
+	{
+		ReleaseReadbackRing();
+	}
+
+	if (!ReadbackRing.IsValid())
+	{
+		ReadbackRing = MakeShared<FLBRReadbackRing, ESPMode::ThreadSafe>(ReadbackRingSize);
+	}
+}
+
+void ALBRuntimeVideoRecorderActor::ReleaseReadbackRing()
+{
+	if (!ReadbackRing.IsValid())
+	{
+		return;
+	}
+
+	// 回读对象持有 RHI 资源，放到渲染线程上释放
+	ENQUEUE_RENDER_COMMAND(LBR_ReleaseReadbackRing)(
+		[Ring = MoveTemp(ReadbackRing)](FRHICommandListImmediate& RHICmdList) mutable
+		{
+			Ring.Reset();
 		});
 }
 
 void ALBRuntimeVideoRecorderActor::ExecuteSceneShot(const FString& FileName)
 {
+	// 存储路径是蓝图事件，只能在游戏线程上取
+	const FString FilePath = FPaths::Combine(GetSceneShotStoragePath(), FileName + TEXT(".png"));
+
+	// PNG 压缩较慢，交给线程池，不占用后处理线程
 	CaptureAsync(
 		RenderTarget,
-		Gamma,
-		Exposure,
-		[this, FileName](const TArray<FColor>& Pixels, int32 Width, int32 Height)
+		GetToneLUT(),
+		[FilePath](FLBRPixelBufferRef Buffer, int32 Width, int32 Height)
 		{
-			if (Pixels.Num() == 0 || Width <= 0 || Height <= 0)
+			if (!Buffer.IsValid() || Buffer->Pixels.Num() == 0 || Width <= 0 || Height <= 0)
 				return;
 
-			FString FilePath = FPaths::Combine(GetSceneShotStoragePath(), FileName + TEXT(".png"));
-
-			Async(EAsyncExecution::ThreadPool, [Pixels, Width, Height, FilePath]()
+			Async(EAsyncExecution::ThreadPool, [Buffer = MoveTemp(Buffer), Width, Height, FilePath]()
 				{
 					TArray64<uint8> PNGData;
-					FImageUtils::PNGCompressImageArray(Width, Height, Pixels, PNGData);
+					FImageUtils::PNGCompressImageArray(Width, Height, Buffer->Pixels, PNGData);
 
 					IFileManager::Get().MakeDirectory(*FPaths::GetPath(FilePath), true);
 					FFileHelper::SaveArrayToFile(PNGData, *FilePath);
@@ -3,10 +3,90 @@
 
 #include "LBSubmixCapture.h"
 #include "AudioDevice.h"
-#include "SampleBuffer.h"
+#include "AudioDeviceManager.h"
+#include "Sound/SoundSubmix.h"
 
 DEFINE_LOG_CATEGORY(LogLBSubmixCapture);
 
+// 退订时最多等在途回调这么久（秒），音频设备停转时不会一直等，超时的环延迟释放
+static constexpr double UnsubscribeWaitSeconds = 0.1;
+
+// 按设备和 submix 共享的监听器，只在游戏线程访问
+static TArray<TSharedPtr<LBSubmixCapture>> GSharedCaptures;
+
+LBSubmixCapture::LBSubmixCapture(uint32 InDeviceId, USoundSubmix* InSubmix)
+	: DeviceId(InDeviceId)
+	, Submix(InSubmix)
+	, bMainSubmix(InSubmix == nullptr)
+{
+	for (TAtomic<FLBRAudioRing*>& Slot : RingSlots)
+	{
+		Slot = nullptr;
+	}
+}
+
+TSharedPtr<LBSubmixCapture> LBSubmixCapture::Subscribe(const FLBRAudioRingPtr& Ring, USoundSubmix* InSubmix)
+{
+	check(IsInGameThread());
+
+	if (!GEngine || !Ring.IsValid())
+	{
+		return nullptr;
+	}
+
+	//FAudioDeviceHandle AudioDevice = GEngine->GetMainAudioDevice();  // AudioData的数据可能全是0.0
+	FAudioDeviceHandle AudioDevice = GEngine->GetActiveAudioDevice();
+	if (!AudioDevice)
+	{
+		UE_LOG(LogLBSubmixCapture, Warning, TEXT("No audio device"));
+		return nullptr;
+	}
+
+	const uint32 DeviceId = AudioDevice.GetDeviceID();
+	TSharedPtr<LBSubmixCapture> Capture;
+	for (const TSharedPtr<LBSubmixCapture>& Existing : GSharedCaptures)
+	{
+		if (Existing->DeviceId == DeviceId && (InSubmix ? Existing->Submix.Get() == InSubmix : Existing->bMainSubmix))
+		{
+			Capture = Existing;
+			break;
+		}
+	}
+
+	if (!Capture.IsValid())
+	{
+		Capture = MakeShared<LBSubmixCapture>(DeviceId, InSubmix);
+		if (!Capture->Initialize())
+		{
+			return nullptr;
+		}
+		GSharedCaptures.Add(Capture);
+	}
+
+	if (!Capture->AddRing(Ring))
+	{
+		UE_LOG(LogLBSubmixCapture, Error, TEXT("Submix capture already has %d subscribers"), MaxSubscribers);
+		return nullptr;
+	}
+
+	UE_LOG(LogLBSubmixCapture, Log, TEXT("Subscribed to %s on device %u (%d sessions)"),
+		InSubmix ? *InSubmix->GetName() : TEXT("main submix"), DeviceId, Capture->GetNumSubscribers());
+	return Capture;
+}
+
+void LBSubmixCapture::Unsubscribe(const TSharedPtr<LBSubmixCapture>& Capture, const FLBRAudioRingPtr& Ring)
+{
+	check(IsInGameThread());
+
+	if (!Capture.IsValid() || Capture->RemoveRing(Ring) > 0)
+	{
+		return;
+	}
+
+	Capture->Uninitialize();
+	GSharedCaptures.Remove(Capture);
+}
+
 bool LBSubmixCapture::Initialize()
 {
 	FScopeLock Lock(&CriticalSection);
@@ -15,22 +95,22 @@ bool LBSubmixCapture::Initialize()
 		return true;
 	}
 
-	if (!GEngine)
+	FAudioDeviceManager* DeviceManager = GEngine ? GEngine->GetAudioDeviceManager() : nullptr;
+	FAudioDeviceHandle AudioDevice = DeviceManager ? DeviceManager->GetAudioDevice(DeviceId) : FAudioDeviceHandle();
+	if (!AudioDevice)
 	{
+		UE_LOG(LogLBSubmixCapture, Warning, TEXT("No audio device"));
 		bInitialized = false;
 		return false;
 	}
 
-	//FAudioDeviceHandle AudioDevice = GEngine->GetMainAudioDevice();  // AudioData的数据可能全是0.0
-	FAudioDeviceHandle AudioDevice = GEngine->GetActiveAudioDevice();
-	if (!AudioDevice)
+	USoundSubmix* TargetSubmix = bMainSubmix ? &AudioDevice->GetMainSubmixObject() : Submix.Get();
+	if (!TargetSubmix)
 	{
-		UE_LOG(LogLBSubmixCapture, Warning, TEXT("No audio device"));
 		bInitialized = false;
 		return false;
 	}
-
-	AudioDevice->RegisterSubmixBufferListener(AsShared(), AudioDevice->GetMainSubmixObject());
+	AudioDevice->RegisterSubmixBufferListener(AsShared(), *TargetSubmix);
 
 	if (GConfig)
 	{
@@ -49,80 +129,123 @@ bool LBSubmixCapture::Uninitialize()
 		return true;
 	}
 
-	if (GEngine)
+	if (FAudioDeviceManager* DeviceManager = GEngine ? GEngine->GetAudioDeviceManager() : nullptr)
 	{
-		//FAudioDeviceHandle AudioDevice = GEngine->GetMainAudioDevice();
-		FAudioDeviceHandle AudioDevice = GEngine->GetActiveAudioDevice();
+		// 指定的 submix 已被回收时设备那边也已经移除了监听
+		FAudioDeviceHandle AudioDevice = DeviceManager->GetAudioDevice(DeviceId);
 		if (AudioDevice)
 		{
-			AudioDevice->UnregisterSubmixBufferListener(AsShared(), AudioDevice->GetMainSubmixObject());
+			USoundSubmix* TargetSubmix = bMainSubmix ? &AudioDevice->GetMainSubmixObject() : Submix.Get();
+			if (TargetSubmix)
+			{
+				AudioDevice->UnregisterSubmixBufferListener(AsShared(), *TargetSubmix);
+			}
 		}
 	}
 
-	RecordingBuffer.Empty();
 	bInitialized = false;
 	return true;
 }
 
-void LBSubmixCapture::OnNewSubmixBuffer(const USoundSubmix* OwningSubmix, float* AudioData, int32 NumSamples, int32 NumChannels, const int32 SampleRate, double AudioClock)
+bool LBSubmixCapture::AddRing(const FLBRAudioRingPtr& Ring)
 {
 	FScopeLock Lock(&CriticalSection);
+	ReleaseDeferredRings();
 
-	if (!bInitialized)
+	for (int32 i = 0; i < MaxSubscribers; ++i)
 	{
-		return;
+		if (!RingOwners[i].IsValid())
+		{
+			RingOwners[i] = Ring;
+			RingSlots[i] = Ring.Get();
+			NumSubscribers++;
+			return true;
+		}
 	}
+	return false;
+}
 
-	CurrentSampleRate = SampleRate;
-	CurrentNumChannels = NumChannels;
-
-	Audio::TSampleBuffer<int16> Buffer(AudioData, NumSamples, NumChannels, SampleRate);
-
-	RecordingBuffer.Append(AudioData, NumSamples);
-
-	const float ChunkDurationSecs = 0.01f; // 10ms
-	const int32 SamplesPer10Ms = GetSamplesPerDurationSecs(ChunkDurationSecs);
-
-	// 发送10ms的数据
-	while (RecordingBuffer.Num() > SamplesPer10Ms)
+int32 LBSubmixCapture::RemoveRing(const FLBRAudioRingPtr& Ring)
+{
+	// 先从表里摘掉，等在途回调结束后再释放引用，音频线程手里的裸指针始终有效
+	FLBRAudioRingPtr Released;
+	int32 Remaining = 0;
 	{
-		// Extract a 10ms chunk of samples from recording buffer
-		FLBRAudioFrame Frame;
-		Frame.NumChannels = CurrentNumChannels;
-		Frame.SampleRate = CurrentSampleRate;
-		Frame.PTS = AudioSampleCursor;
-
-		Frame.Samples.Append(
-			RecordingBuffer.GetData(),
-			SamplesPer10Ms
-		);
+		FScopeLock Lock(&CriticalSection);
+		ReleaseDeferredRings();
 
-		AudioSampleCursor += SamplesPer10Ms / CurrentNumChannels;
+		for (int32 i = 0; i < MaxSubscribers; ++i)
+		{
+			if (RingOwners[i].IsValid() && RingOwners[i] == Ring)
+			{
+				RingSlots[i] = nullptr;
+				Released = MoveTemp(RingOwners[i]);
+				NumSubscribers--;
+				break;
+			}
+		}
+		Remaining = NumSubscribers;
+	}
 
-		// Remove 10ms of samples from the recording buffer now it is submitted
-		RecordingBuffer.RemoveAt(0, SamplesPer10Ms, EAllowShrinking::No);
+	const int64 Serial = CallbackSerial.GetValue();
+	if (Released.IsValid() && (Serial & 1))
+	{
+		const double Deadline = FPlatformTime::Seconds() + UnsubscribeWaitSeconds;
+		while (CallbackSerial.GetValue() == Serial && FPlatformTime::Seconds() < Deadline)
+		{
+			FPlatformProcess::Sleep(0.001f);
+		}
 
-		if (OnAudioFrame.IsBound())
+		// 回调被抢占还没写完，环不能在这里释放，交给之后的订阅操作或析构
+		if (CallbackSerial.GetValue() == Serial)
 		{
-			OnAudioFrame.Execute(MoveTemp(Frame));
+			FScopeLock Lock(&CriticalSection);
+			DeferredReleases.Emplace(Serial, MoveTemp(Released));
 		}
 	}
+	return Remaining;
+}
 
+void LBSubmixCapture::ReleaseDeferredRings()
+{
+	const int64 Serial = CallbackSerial.GetValue();
+	DeferredReleases.RemoveAll([Serial](const TPair<int64, FLBRAudioRingPtr>& Deferred)
+		{
+			return Deferred.Key != Serial;
+		});
 }
 
-const FString& LBSubmixCapture::GetListenerName() const
+int32 LBSubmixCapture::GetNumSubscribers() const
 {
-	static const FString ListenerName = TEXT("LBSubmixCapture");
-	return ListenerName;
+	FScopeLock Lock(&CriticalSection);
+	return NumSubscribers;
 }
 
-int32 LBSubmixCapture::GetSamplesPerDurationSecs(float InSeconds) const
+void LBSubmixCapture::OnNewSubmixBuffer(const USoundSubmix* OwningSubmix, float* AudioData, int32 NumSamples, int32 NumChannels, const int32 SampleRate, double AudioClock)
 {
-	if (CurrentSampleRate <= 0 || CurrentNumChannels <= 0)
+	// 音频渲染线程：不加锁、不分配，同一块数据依次写入各会话预分配的环，切块交给各自的编码阶段
+	if (!bInitialized || NumChannels <= 0)
 	{
-		return 0;
+		return;
 	}
 
-	const int32 SamplesPerSecond = CurrentSampleRate * CurrentNumChannels;
-	return FMath::RoundToInt(SamplesPerSecond * InSeconds);
+	CallbackSerial.Increment();
+	for (int32 i = 0; i < MaxSubscribers; ++i)
+	{
+		if (FLBRAudioRing* Ring = RingSlots[i].Load())
+		{
+			Ring->SetFormat(NumChannels, SampleRate);
+			Ring->NoteFirstClock(AudioClock);
+			Ring->Write(AudioData, NumSamples);
+		}
+	}
+	CallbackSerial.Increment();
+
+	CapturedFrames.Add(NumSamples / NumChannels);
+}
+
+const FString& LBSubmixCapture::GetListenerName() const
+{
+	static const FString ListenerName = TEXT("LBSubmixCapture");
+	return ListenerName;
 }
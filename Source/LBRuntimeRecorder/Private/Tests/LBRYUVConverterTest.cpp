@@ -0,0 +1,173 @@
+#include "LBRYUVConverter.h"
+#include "LBRColorCorrection.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+
+extern "C"
+{
+#include <libswscale/swscale.h>
+#include <libavutil/pixfmt.h>
+}
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	struct FLBRTestPlanes
+	{
+		TArray<uint8> Y;
+		TArray<uint8> U;
+		TArray<uint8> V;
+		FLBRYUV420Planes Planes;
+
+		// 目标行距故意比宽度多几字节，检查不会越界写
+		FLBRTestPlanes(int32 Width, int32 Height)
+		{
+			const int32 ChromaWidth = (Width + 1) / 2;
+			const int32 ChromaHeight = (Height + 1) / 2;
+			Planes.YStride = Width + 7;
+			Planes.UStride = ChromaWidth + 5;
+			Planes.VStride = ChromaWidth + 5;
+			Y.Init(0xCD, Planes.YStride * Height);
+			U.Init(0xCD, Planes.UStride * ChromaHeight);
+			V.Init(0xCD, Planes.VStride * ChromaHeight);
+			Planes.Y = Y.GetData();
+			Planes.U = U.GetData();
+			Planes.V = V.GetData();
+		}
+	};
+
+	TArray<FColor> MakeNoise(int32 Stride, int32 Height, int32 Seed)
+	{
+		FRandomStream Random(Seed);
+		TArray<FColor> Pixels;
+		Pixels.SetNumUninitialized(Stride * Height);
+		for (FColor& Pixel : Pixels)
+		{
+			Pixel = FColor(uint8(Random.RandRange(0, 255)), uint8(Random.RandRange(0, 255)), uint8(Random.RandRange(0, 255)), uint8(Random.RandRange(0, 255)));
+		}
+		return Pixels;
+	}
+
+	// 返回最大逐字节差；Width 为有效列数，行距之外的填充不比较
+	int32 MaxPlaneDiff(const uint8* A, int32 StrideA, const uint8* B, int32 StrideB, int32 Width, int32 Height)
+	{
+		int32 MaxDiff = 0;
+		for (int32 Y = 0; Y < Height; ++Y)
+		{
+			for (int32 X = 0; X < Width; ++X)
+			{
+				MaxDiff = FMath::Max(MaxDiff, FMath::Abs(int32(A[int64(Y) * StrideA + X]) - int32(B[int64(Y) * StrideB + X])));
+			}
+		}
+		return MaxDiff;
+	}
+
+	int32 MaxDiff(const FLBRTestPlanes& A, const FLBRTestPlanes& B, int32 Width, int32 Height)
+	{
+		const int32 ChromaWidth = (Width + 1) / 2;
+		const int32 ChromaHeight = (Height + 1) / 2;
+		return FMath::Max3(
+			MaxPlaneDiff(A.Planes.Y, A.Planes.YStride, B.Planes.Y, B.Planes.YStride, Width, Height),
+			MaxPlaneDiff(A.Planes.U, A.Planes.UStride, B.Planes.U, B.Planes.UStride, ChromaWidth, ChromaHeight),
+			MaxPlaneDiff(A.Planes.V, A.Planes.VStride, B.Planes.V, B.Planes.VStride, ChromaWidth, ChromaHeight));
+	}
+
+	// 原编码线程的路径：swscale BGRA -> YUV420P，SWS_BILINEAR，同尺寸
+	void ConvertSws(const FColor* Src, int32 SrcStride, int32 Width, int32 Height, const FLBRYUV420Planes& Dst)
+	{
+		SwsContext* Ctx = sws_getContext(Width, Height, AV_PIX_FMT_BGRA, Width, Height, AV_PIX_FMT_YUV420P, SWS_BILINEAR, nullptr, nullptr, nullptr);
+		if (!Ctx)
+		{
+			return;
+		}
+
+		const uint8* SrcData[] = { reinterpret_cast<const uint8*>(Src) };
+		const int SrcLinesize[] = { SrcStride * 4 };
+		uint8* DstData[] = { Dst.Y, Dst.U, Dst.V };
+		const int DstLinesize[] = { Dst.YStride, Dst.UStride, Dst.VStride };
+		sws_scale(Ctx, SrcData, SrcLinesize, 0, Height, DstData, DstLinesize);
+		sws_freeContext(Ctx);
+	}
+}
+
+// SSE4.1 / NEON 与标量参考实现逐位一致：奇数宽高、行距大于宽度、带或不带调色表、串行与并行
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLBRYUVConverterMatchesReferenceTest, "LBRuntimeRecorder.YUVConverter.MatchesReference",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::ProductFilter)
+
+bool FLBRYUVConverterMatchesReferenceTest::RunTest(const FString& Parameters)
+{
+	FLBRToneLUT LUT;
+	LUT.Build(2.2f, 1.3f);
+
+	const FIntPoint Sizes[] = { { 2, 2 }, { 1, 1 }, { 17, 9 }, { 255, 33 }, { 256, 64 }, { 513, 37 }, { 1280, 721 } };
+	for (const FIntPoint& Size : Sizes)
+	{
+		for (const int32 Padding : { 0, 13 })
+		{
+			const int32 Stride = Size.X + Padding;
+			const TArray<FColor> Src = MakeNoise(Stride, Size.Y, Size.X * 31 + Size.Y + Padding);
+
+			for (const FLBRToneLUT* TestLUT : { static_cast<const FLBRToneLUT*>(nullptr), &LUT })
+			{
+				FLBRTestPlanes Reference(Size.X, Size.Y);
+				FLBRYUVConverter::ConvertReference(Src.GetData(), Stride, Size.X, Size.Y, TestLUT, Reference.Planes);
+
+				for (const bool bParallel : { false, true })
+				{
+					FLBRTestPlanes Result(Size.X, Size.Y);
+					FLBRYUVConverter::Convert(Src.GetData(), Stride, Size.X, Size.Y, TestLUT, Result.Planes, bParallel);
+
+					TestEqual(FString::Printf(TEXT("%dx%d stride %d LUT %d parallel %d"), Size.X, Size.Y, Stride, TestLUT != nullptr, bParallel),
+						MaxDiff(Result, Reference, Size.X, Size.Y), 0);
+					TestTrue(TEXT("Destination padding untouched"), Result.Y.Last() == 0xCD && Result.U.Last() == 0xCD && Result.V.Last() == 0xCD);
+				}
+			}
+		}
+	}
+	return true;
+}
+
+// 与原 swscale 路径的差不超过 ±1。色度的取样位置和滤波与 swscale 不同，
+// 所以色度只在 2x2 块内颜色一致的图上比较：纯色，以及灰度噪声（色度恒为 128）
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLBRYUVConverterMatchesSwscaleTest, "LBRuntimeRecorder.YUVConverter.MatchesSwscale",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::ClientContext | EAutomationTestFlags::ProductFilter)
+
+bool FLBRYUVConverterMatchesSwscaleTest::RunTest(const FString& Parameters)
+{
+	const int32 Width = 318;
+	const int32 Height = 178;
+
+	TArray<TArray<FColor>> Images;
+	for (const FColor Color : { FColor::Black, FColor::White, FColor::Red, FColor::Green, FColor::Blue, FColor(128, 128, 128), FColor(200, 120, 40), FColor(16, 235, 90) })
+	{
+		TArray<FColor>& Pixels = Images.AddDefaulted_GetRef();
+		Pixels.Init(Color, Width * Height);
+	}
+
+	{
+		FRandomStream Random(42);
+		TArray<FColor>& Pixels = Images.AddDefaulted_GetRef();
+		Pixels.SetNumUninitialized(Width * Height);
+		for (FColor& Pixel : Pixels)
+		{
+			const uint8 Grey = uint8(Random.RandRange(0, 255));
+			Pixel = FColor(Grey, Grey, Grey);
+		}
+	}
+
+	for (int32 i = 0; i < Images.Num(); ++i)
+	{
+		FLBRTestPlanes Result(Width, Height);
+		FLBRYUVConverter::Convert(Images[i].GetData(), Width, Width, Height, nullptr, Result.Planes);
+
+		FLBRTestPlanes Sws(Width, Height);
+		ConvertSws(Images[i].GetData(), Width, Width, Height, Sws.Planes);
+
+		const int32 Diff = MaxDiff(Result, Sws, Width, Height);
+		TestTrue(FString::Printf(TEXT("Image %d differs from swscale by %d"), i, Diff), Diff <= 1);
+	}
+	return true;
+}
+
+#endif // WITH_DEV_AUTOMATION_TESTS
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/ThreadSafeCounter64.h"
+
+extern "C"
+{
+#include <libavformat/avio.h>
+}
+
+class IFileHandle;
+
+DECLARE_LOG_CATEGORY_EXTERN(LogLBRAsyncFileWriter, Log, All);
+
+// AVIO 写回调的缓冲参数在 FFmpeg 7 起改为 const
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+typedef const uint8_t* FLBRAVIOWriteBuffer;
+#else
+typedef uint8_t* FLBRAVIOWriteBuffer;
+#endif
+
+struct FLBRFileWriteStats
+{
+	int64 BytesWritten = 0;
+	int64 BytesPending = 0;       // 已交给写线程、尚未落盘
+	int64 PeakBytesPending = 0;
+	int64 Writes = 0;
+	double AvgWriteMs = 0.0;
+	double MaxWriteMs = 0.0;
+	int64 ProducerStalls = 0;     // 缓冲块全部在途，mux 等待空闲块的次数
+	int64 Errors = 0;
+};
+
+// 多个 writer（分段）累加到同一组计数，任意线程可读
+struct FLBRFileWriteCounters
+{
+	FThreadSafeCounter64 BytesWritten;
+	FThreadSafeCounter64 BytesPending;
+	FThreadSafeCounter64 PeakBytesPending;
+	FThreadSafeCounter64 Writes;
+	FThreadSafeCounter64 WriteCycles;
+	FThreadSafeCounter64 MaxWriteCycles;
+	FThreadSafeCounter64 ProducerStalls;
+	FThreadSafeCounter64 Errors;
+
+	FLBRFileWriteStats Snapshot() const;
+};
+typedef TSharedPtr<FLBRFileWriteCounters, ESPMode::ThreadSafe> FLBRFileWriteCountersPtr;
+
+// muxer 下面的写后缓冲：AVIOContext 的写入先拷进预分配的大块，写满一块交给专用写线程落盘
+// mux 线程只做内存拷贝，块全部在途时才等待；回写文件头等随机写按提交顺序在写线程上执行
+// Linux 上可选 O_DIRECT（整块对齐写入绕过页缓存，尾部和随机写走普通句柄）
+class LBRUNTIMERECORDER_API FLBRAsyncFileWriter
+{
+public:
+	static constexpr int32 ChunkSize = 1024 * 1024;
+	static constexpr int32 ChunkAlignment = 4096;
+
+	FLBRAsyncFileWriter(const FLBRFileWriteCountersPtr& InCounters, int32 InBufferMegabytes, bool bInDirectIO);
+	~FLBRAsyncFileWriter();
+
+	// 打开文件、分配缓冲并启动写线程
+	bool Open(const FString& InFilePath);
+
+	// 交给 AVFormatContext::pb，同时需设置 AVFMT_FLAG_CUSTOM_IO；所有权仍归本对象
+	AVIOContext* GetAVIOContext() const { return IOContext; }
+
+	// 刷出剩余数据，等写线程写完后关闭文件；返回是否全部写入成功
+	bool Close();
+
+private:
+	class FWriter : public FRunnable
+	{
+	public:
+		explicit FWriter(FLBRAsyncFileWriter& InOwner) : Owner(InOwner) {}
+		virtual uint32 Run() override;
+
+	private:
+		FLBRAsyncFileWriter& Owner;
+	};
+
+	struct FRequest
+	{
+		uint8* Chunk = nullptr;     // 非空时写完归还空闲块
+		TArray<uint8> Patch;        // 落在已提交区域内的随机写
+		int64 Offset = 0;
+		int32 Size = 0;
+	};
+
+	static int WritePacket(void* Opaque, FLBRAVIOWriteBuffer Buffer, int BufferSize);
+	static int64_t SeekPacket(void* Opaque, int64_t Offset, int Whence);
+
+	// 以下在 mux（生产者）线程上执行
+	void Write(const uint8* Data, int32 Size);
+	void Append(const uint8* Data, int32 Size, bool bZeroFill);
+	void SubmitChunk();
+	void Submit(FRequest&& Request);
+
+	// 以下在写线程上执行
+	void RunWriter();
+	bool WriteRequest(const FRequest& Request);
+
+	bool OpenFile();
+	void CloseFile();
+	bool WriteAt(const uint8* Data, int32 Size, int64 Offset, bool bAligned);
+
+private:
+	FLBRFileWriteCountersPtr Counters;
+	int32 NumChunks;
+	bool bDirectIO;
+	FString FilePath;
+
+	AVIOContext* IOContext = nullptr;
+
+	// 生产者状态：当前块覆盖 [ChunkStart, AppendPos)
+	uint8* CurrentChunk = nullptr;
+	int64 ChunkStart = 0;
+	int64 AppendPos = 0;
+	int64 Position = 0;
+
+	TArray<uint8*> AllChunks;
+	TQueue<uint8*, EQueueMode::Mpsc> FreeChunks;      // 写线程（以及生产者自己）归还，生产者取
+	TQueue<FRequest, EQueueMode::Spsc> Requests;      // 生产者提交，写线程取
+	FEvent* RequestEvent = nullptr;
+	FEvent* FreeEvent = nullptr;
+
+	FWriter* Writer = nullptr;
+	FRunnableThread* WriterThread = nullptr;
+	FThreadSafeBool bClosing = false;
+	FThreadSafeBool bFailed = false;
+
+	// 平台文件句柄，只在写线程上使用
+#if PLATFORM_LINUX
+	int Fd = -1;
+	int DirectFd = -1;
+#else
+	IFileHandle* Handle = nullptr;
+#endif
+};
+
+typedef TSharedPtr<FLBRAsyncFileWriter, ESPMode::ThreadSafe> FLBRAsyncFileWriterPtr;
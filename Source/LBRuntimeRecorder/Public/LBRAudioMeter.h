@@ -0,0 +1,37 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "HAL/ThreadSafeCounter64.h"
+
+// 编码侧的音频电平统计：音频阶段每送一块给编码器前更新一次，任意线程无锁读取
+// 音频渲染线程上不做任何统计、格式化或日志
+class LBRUNTIMERECORDER_API FLBRAudioMeter
+{
+public:
+	static constexpr int32 MaxChannels = 8;
+
+	// 仅音频阶段调用；Interleaved 含 NumFrames * NumChannels 个样本，超出 MaxChannels 的声道不统计
+	void Process(const float* Interleaved, int32 NumFrames, int32 NumChannels);
+
+	// 距上次输出超过 IntervalSeconds 时打一条汇总日志（区间内峰值和平均 RMS），仅音频阶段调用
+	void LogSummaryIfDue(double Now, double IntervalSeconds);
+
+	// 以下任意线程：最近一块的每声道峰值 / RMS（线性幅度）
+	int32 GetNumChannels() const { return NumChannels.GetValue(); }
+	float GetPeak(int32 Channel) const;
+	float GetRMS(int32 Channel) const;
+	int64 GetClippedBlocks() const { return ClippedBlocks.GetValue(); }
+
+private:
+	FThreadSafeCounter NumChannels;
+	FThreadSafeCounter PeakBits[MaxChannels];   // float 按位存放
+	FThreadSafeCounter RMSBits[MaxChannels];
+	FThreadSafeCounter64 ClippedBlocks;          // 有声道峰值达到满刻度的块数
+
+	// 以下仅音频阶段使用：日志区间内的累计
+	float IntervalPeak[MaxChannels] = {};
+	double IntervalSumSquares[MaxChannels] = {};
+	int64 IntervalFrames = 0;
+	double LastLogTime = 0.0;
+};
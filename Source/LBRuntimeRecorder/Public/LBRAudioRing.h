@@ -0,0 +1,136 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "HAL/ThreadSafeCounter64.h"
+#include "HAL/ThreadSafeBool.h"
+
+// 单生产者 / 单消费者的无锁浮点环形缓冲，容量固定为 2 的幂，构造时一次分配
+// 生产者（音频渲染线程）写入时不加锁、不分配；消费者按块读取，只有块跨越环尾时才拷贝
+class FLBRAudioRing
+{
+public:
+	explicit FLBRAudioRing(int32 InMinCapacity)
+	{
+		Capacity = int32(FMath::RoundUpToPowerOfTwo(uint32(FMath::Max(InMinCapacity, 1024))));
+		Mask = Capacity - 1;
+		Buffer.SetNumZeroed(Capacity);
+	}
+
+	// ---- 生产者 ----
+
+	// 格式在首次写入前设置；之后不应再改变
+	void SetFormat(int32 InNumChannels, int32 InSampleRate)
+	{
+		SampleRate.Set(InSampleRate);
+		NumChannels.Set(InNumChannels);
+	}
+
+	// 第一次写入前调用，记下首个样本的音频设备时钟（秒）；同一设备上各 submix 同一块的时钟相同，多条轨据此对齐起点
+	void NoteFirstClock(double AudioClock)
+	{
+		if (!bHasFirstClock)
+		{
+			int64 Bits = 0;
+			FMemory::Memcpy(&Bits, &AudioClock, sizeof(Bits));
+			FirstClockBits.Set(Bits);
+			bHasFirstClock = true;
+		}
+	}
+
+	// 返回实际写入的样本数，空间不足的部分丢弃并计数；只写整帧，消费者按交错帧读取时声道不会错位
+	int32 Write(const float* Data, int32 Num)
+	{
+		const int64 Head = WritePos.GetValue();
+		const int64 Tail = ReadPos.GetValue();
+		const int32 Free = Capacity - int32(Head - Tail);
+		const int32 Channels = FMath::Max(1, NumChannels.GetValue());
+		const int32 ToWrite = FMath::Min(Num, Free) / Channels * Channels;
+
+		if (ToWrite < Num)
+		{
+			Overflowed.Add(Num - ToWrite);
+		}
+
+		if (ToWrite > 0)
+		{
+			const int32 Start = int32(Head & Mask);
+			const int32 First = FMath::Min(ToWrite, Capacity - Start);
+			FMemory::Memcpy(Buffer.GetData() + Start, Data, First * sizeof(float));
+			if (ToWrite > First)
+			{
+				FMemory::Memcpy(Buffer.GetData(), Data + First, (ToWrite - First) * sizeof(float));
+			}
+
+			// 数据写完后才发布新的写位置
+			WritePos.Set(Head + ToWrite);
+		}
+		return ToWrite;
+	}
+
+	// ---- 消费者 ----
+
+	int32 NumReadable() const
+	{
+		return int32(WritePos.GetValue() - ReadPos.GetValue());
+	}
+
+	// 取 Num 个样本的只读视图（调用方保证 NumReadable() >= Num）
+	// 未跨越环尾时直接指向环内存，否则拷到 Scratch 并返回 Scratch
+	const float* Peek(int32 Num, float* Scratch) const
+	{
+		const int32 Start = int32(ReadPos.GetValue() & Mask);
+		const int32 First = Capacity - Start;
+		if (Num <= First)
+		{
+			return Buffer.GetData() + Start;
+		}
+
+		FMemory::Memcpy(Scratch, Buffer.GetData() + Start, First * sizeof(float));
+		FMemory::Memcpy(Scratch + First, Buffer.GetData(), (Num - First) * sizeof(float));
+		return Scratch;
+	}
+
+	// 读完后归还空间
+	void Consume(int32 Num)
+	{
+		ReadPos.Set(ReadPos.GetValue() + Num);
+	}
+
+	// ---- 任意线程 ----
+
+	int32 GetCapacity() const { return Capacity; }
+	int32 GetNumChannels() const { return NumChannels.GetValue(); }
+	int32 GetSampleRate() const { return SampleRate.GetValue(); }
+	int64 GetTotalWritten() const { return WritePos.GetValue(); }
+	int64 GetOverflowedSamples() const { return Overflowed.GetValue(); }
+
+	bool GetFirstClock(double& OutClock) const
+	{
+		if (!bHasFirstClock)
+		{
+			return false;
+		}
+		const int64 Bits = FirstClockBits.GetValue();
+		FMemory::Memcpy(&OutClock, &Bits, sizeof(OutClock));
+		return true;
+	}
+
+private:
+	TArray<float> Buffer;
+	int32 Capacity = 0;
+	int32 Mask = 0;
+
+	// 单调递增的绝对位置，取模后才是下标
+	FThreadSafeCounter64 WritePos;
+	FThreadSafeCounter64 ReadPos;
+	FThreadSafeCounter64 Overflowed;
+
+	FThreadSafeCounter NumChannels;
+	FThreadSafeCounter SampleRate;
+
+	FThreadSafeCounter64 FirstClockBits;
+	FThreadSafeBool bHasFirstClock = false;
+};
+
+typedef TSharedPtr<FLBRAudioRing, ESPMode::ThreadSafe> FLBRAudioRingPtr;
@@ -0,0 +1,198 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Deque.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/ScopeLock.h"
+#include "LBRTypes.h"
+
+struct FLBRBoundedQueueStats
+{
+	int64 Pushed = 0;
+	int64 Blocked = 0;         // BlockProducer：等待过空位的次数
+	int64 DroppedOldest = 0;   // DropOldest：被挤掉的旧项
+	int64 DroppedNewest = 0;   // DropNewest：直接丢弃的新项
+	int64 OverCap = 0;         // NeverDrop：超限后仍入队的次数
+	int32 PeakNum = 0;
+	int64 PeakBytes = 0;
+};
+
+// 多生产者 / 单消费者的有界队列，按条数和字节数双重限制
+template<typename T>
+class TLBRBoundedQueue
+{
+public:
+	TLBRBoundedQueue(int32 InMaxNum, int64 InMaxBytes, ELBRQueueFullPolicy InPolicy)
+		: MaxNum(FMath::Max(1, InMaxNum))
+		, MaxBytes(FMath::Max<int64>(1, InMaxBytes))
+		, Policy(InPolicy)
+	{
+		SpaceEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	}
+
+	~TLBRBoundedQueue()
+	{
+		FPlatformProcess::ReturnSynchEventToPool(SpaceEvent);
+		SpaceEvent = nullptr;
+	}
+
+	// DropOldest 挤掉的旧项在 OutEvicted 不为空时移交给调用方，否则直接析构
+	ELBRPushResult Push(T&& Item, int64 ItemBytes, TArray<T>* OutEvicted = nullptr)
+	{
+		bool bWaited = false;
+		while (true)
+		{
+			FScopeLock Lock(&Mutex);
+
+			if (bClosed)
+			{
+				return ELBRPushResult::Rejected;
+			}
+
+			// 队列为空时总是允许入队，避免单项超过字节上限时永远进不去
+			const bool bFull = Items.Num() > 0 && (Items.Num() >= MaxNum || Bytes + ItemBytes > MaxBytes);
+			if (!bFull)
+			{
+				Add(MoveTemp(Item), ItemBytes);
+				return bWaited ? ELBRPushResult::QueuedAfterBlocking : ELBRPushResult::Queued;
+			}
+
+			switch (Policy)
+			{
+			case ELBRQueueFullPolicy::DropOldest:
+			{
+				// 被挤掉的旧项随即析构，像素缓冲归还给池
+				while (Items.Num() > 0 && (Items.Num() >= MaxNum || Bytes + ItemBytes > MaxBytes))
+				{
+					if (OutEvicted)
+					{
+						OutEvicted->Add(MoveTemp(Items.First().Item));
+					}
+					Bytes -= Items.First().Bytes;
+					Items.PopFirst();
+					Stats.DroppedOldest++;
+				}
+				Add(MoveTemp(Item), ItemBytes);
+				return ELBRPushResult::QueuedDroppedOldest;
+			}
+
+			case ELBRQueueFullPolicy::DropNewest:
+				Stats.DroppedNewest++;
+				return ELBRPushResult::DroppedNewest;
+
+			case ELBRQueueFullPolicy::NeverDrop:
+				Add(MoveTemp(Item), ItemBytes);
+				Stats.OverCap++;
+				return ELBRPushResult::QueuedOverCap;
+
+			case ELBRQueueFullPolicy::BlockProducer:
+			default:
+				if (!bWaited)
+				{
+					Stats.Blocked++;
+					bWaited = true;
+				}
+				break;
+			}
+
+			// 释放锁后等待消费者腾出空位
+			Lock.Unlock();
+			SpaceEvent->Wait(10);
+		}
+	}
+
+	bool Pop(T& OutItem)
+	{
+		{
+			FScopeLock Lock(&Mutex);
+			if (Items.Num() == 0)
+			{
+				return false;
+			}
+
+			OutItem = MoveTemp(Items.First().Item);
+			Bytes -= Items.First().Bytes;
+			Items.PopFirst();
+		}
+
+		SpaceEvent->Trigger();
+		return true;
+	}
+
+	// 停止接收新项并唤醒阻塞中的生产者，已入队的项仍可 Pop
+	void Close()
+	{
+		{
+			FScopeLock Lock(&Mutex);
+			bClosed = true;
+		}
+		SpaceEvent->Trigger();
+	}
+
+	// 需在开始入队前调用
+	void SetPolicy(ELBRQueueFullPolicy InPolicy)
+	{
+		FScopeLock Lock(&Mutex);
+		Policy = InPolicy;
+	}
+
+	// 已达到条数或字节上限
+	bool IsFull() const
+	{
+		FScopeLock Lock(&Mutex);
+		return Items.Num() > 0 && (Items.Num() >= MaxNum || Bytes >= MaxBytes);
+	}
+
+	bool IsEmpty() const
+	{
+		FScopeLock Lock(&Mutex);
+		return Items.Num() == 0;
+	}
+
+	int32 Num() const
+	{
+		FScopeLock Lock(&Mutex);
+		return Items.Num();
+	}
+
+	int64 NumBytes() const
+	{
+		FScopeLock Lock(&Mutex);
+		return Bytes;
+	}
+
+	FLBRBoundedQueueStats GetStats() const
+	{
+		FScopeLock Lock(&Mutex);
+		return Stats;
+	}
+
+private:
+	struct FEntry
+	{
+		T Item;
+		int64 Bytes = 0;
+	};
+
+	void Add(T&& Item, int64 ItemBytes)
+	{
+		Items.EmplaceLast(FEntry{ MoveTemp(Item), ItemBytes });
+		Bytes += ItemBytes;
+		Stats.Pushed++;
+		Stats.PeakNum = FMath::Max(Stats.PeakNum, Items.Num());
+		Stats.PeakBytes = FMath::Max(Stats.PeakBytes, Bytes);
+	}
+
+private:
+	mutable FCriticalSection Mutex;
+	TDeque<FEntry> Items;
+	int64 Bytes = 0;
+	bool bClosed = false;
+
+	int32 MaxNum;
+	int64 MaxBytes;
+	ELBRQueueFullPolicy Policy;
+
+	FEvent* SpaceEvent = nullptr;
+	FLBRBoundedQueueStats Stats;
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// 从已录制的文件中截取片段：只读取覆盖 [StartSec, EndSec) 的 GOP，按流拷贝重新封装，不解码不编码
+// 片段从不晚于 StartSec 的关键帧开始，所以实际起点可能略早于 StartSec
+class LBRUNTIMERECORDER_API FLBRClipExtractor
+{
+public:
+	typedef TFunction<void(const FString& OutFile, bool bSuccess)> FOnClipExtracted;
+
+	// 同步执行，可在任意线程调用；输出封装格式由 OutFile 扩展名决定
+	// 有 .kidx 索引时 MPEG-TS 按字节偏移直接定位，MP4 / Matroska 使用文件自带的索引
+	static bool ExtractClip(const FString& SourceFile, double StartSec, double EndSec, const FString& OutFile);
+
+	// 在线程池上执行，完成后在线程池上回调
+	static void ExtractClipAsync(const FString& SourceFile, double StartSec, double EndSec, const FString& OutFile, FOnClipExtracted&& OnExtracted);
+};
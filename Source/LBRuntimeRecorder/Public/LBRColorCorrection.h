@@ -0,0 +1,25 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// 8bit 输入的 Gamma/曝光 查找表，只在参数变化时重建
+struct LBRUNTIMERECORDER_API FLBRToneLUT
+{
+	uint8 Table[256];
+	float Gamma = 1.f;
+	float Exposure = 1.f;
+	bool bIdentity = true;
+
+	FLBRToneLUT();
+
+	void Build(float InGamma, float InExposure);
+	bool Matches(float InGamma, float InExposure) const;
+
+	// 对 B/G/R 查表，Alpha 不变
+	void Apply(FColor* Pixels, int32 NumPixels) const;
+
+	// 按行分带交给任务线程并行处理
+	void ApplyParallel(FColor* Pixels, int32 Width, int32 Height) const;
+};
+
+typedef TSharedPtr<const FLBRToneLUT, ESPMode::ThreadSafe> FLBRToneLUTPtr;
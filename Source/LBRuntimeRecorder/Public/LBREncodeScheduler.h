@@ -0,0 +1,84 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "LBRFFmpegEncodeThread.h"
+#include "LBRTypes.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogLBREncodeScheduler, Log, All);
+
+// 所有录制会话共用的编码工作线程池：线程数、优先级和亲和性固定，总编码 CPU 不随录制器数量增长
+// 每个会话拆成 mux / 音频 / 视频三个阶段，工作线程按会话轮转领取阶段时间片，同一阶段同一时刻只在一个线程上执行
+class LBRUNTIMERECORDER_API FLBREncodeScheduler
+{
+public:
+	typedef TSharedPtr<FLBRFFmpegEncodeThread, ESPMode::ThreadSafe> FEncoderPtr;
+
+	explicit FLBREncodeScheduler(const FLBREncodeSchedulerSettings& InSettings);
+	~FLBREncodeScheduler();
+
+	// 代替 FRunnableThread::Create：Init 在工作线程上执行，之后与其他会话轮转
+	void AddSession(const FEncoderPtr& Encoder);
+
+	// 调用方先 StopRecording，再等会话收尾完成（含 Init 失败）；返回后调度器不再持有该编码器
+	void WaitForSession(const FLBRFFmpegEncodeThread* Encoder);
+
+	// 停止所有会话并等待收尾，然后结束工作线程
+	void Shutdown();
+
+	int32 GetNumWorkers() const { return Threads.Num(); }
+	int32 GetNumSessions() const;
+	const FLBREncodeSchedulerSettings& GetSettings() const { return Settings; }
+
+private:
+	static constexpr int32 NumStages = int32(FLBRFFmpegEncodeThread::EStage::Num);
+
+	struct FSession
+	{
+		FEncoderPtr Encoder;
+		FEvent* DoneEvent = nullptr;
+		bool bInitialized = false;
+		bool bClaimed = false;               // Init 或收尾中，整个会话被一个线程占用
+		bool bStageBusy[NumStages] = {};
+		bool bStageFinished[NumStages] = {};
+		bool bDone = false;
+	};
+
+	struct FClaim
+	{
+		TSharedPtr<FSession> Session;
+		int32 Stage = INDEX_NONE;            // INDEX_NONE 表示 Init
+	};
+
+	class FWorker : public FRunnable
+	{
+	public:
+		explicit FWorker(FLBREncodeScheduler& InOwner) : Owner(InOwner) {}
+		virtual uint32 Run() override;
+
+	private:
+		FLBREncodeScheduler& Owner;
+	};
+
+	bool ClaimWork(FClaim& OutClaim);
+	// 返回是否处理了数据
+	bool Execute(const FClaim& Claim);
+	void MarkDone(FSession& Session);
+	int32 GetNumSlots() const;
+
+private:
+	FLBREncodeSchedulerSettings Settings;
+
+	mutable FCriticalSection Mutex;
+	TArray<TSharedPtr<FSession>> Sessions;
+	int32 NextSlot = 0;                      // 轮转起点：会话序号 * NumStages + 阶段
+
+	// 有新工作时由编码器触发，自动重置，一次唤醒一个工作线程
+	FEvent* WorkEvent = nullptr;
+
+	TArray<FWorker*> Workers;
+	TArray<FRunnableThread*> Threads;
+
+	FThreadSafeBool bStopping = false;
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/EngineSubsystem.h"
+#include "LBRTypes.h"
+#include "LBREncodeSchedulerSubsystem.generated.h"
+
+class FLBREncodeScheduler;
+
+// 进程级的共享编码调度器，各录制器的编码会话都交给它的固定工作线程池
+// 设置读自 DefaultEngine.ini 的 [/Script/LBRuntimeRecorder.LBREncodeSchedulerSubsystem]，在第一次录制前生效
+UCLASS(Config = Engine)
+class LBRUNTIMERECORDER_API ULBREncodeSchedulerSubsystem : public UEngineSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	// 引擎未初始化时返回 nullptr
+	static ULBREncodeSchedulerSubsystem* Get();
+
+	// 首次调用时按 Settings 创建工作线程
+	FLBREncodeScheduler& GetScheduler();
+
+	// 已创建工作线程后修改不生效
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "LBRuntimeVideoRecorder | Encode Scheduler", meta = (DisplayName = "编码调度器"))
+	FLBREncodeSchedulerSettings Settings;
+
+	UFUNCTION(BlueprintPure, Category = "LBRuntimeVideoRecorder | Encode Scheduler")
+	int32 GetNumActiveSessions() const;
+
+private:
+	TUniquePtr<FLBREncodeScheduler> Scheduler;
+	FCriticalSection SchedulerMutex;
+};
@@ -1,9 +1,16 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Async/Future.h"
 #include "HAL/Runnable.h"
 #include "HAL/ThreadSafeBool.h"
-#include "Containers/Queue.h"
+#include "HAL/ThreadSafeCounter64.h"
+#include "LBRAsyncFileWriter.h"
+#include "LBRAudioMeter.h"
+#include "LBRAudioRing.h"
+#include "LBRBoundedQueue.h"
+#include "LBRKeyframeIndex.h"
+#include "LBRReorderWindow.h"
 #include "LBRTypes.h"
 
 extern "C"
@@ -13,10 +20,33 @@ extern "C"
 #include <libswscale/swscale.h>
 #include <libavutil/opt.h> // av_opt_set
 #include <libswresample/swresample.h> //SwrContext
+#include <libavutil/audio_fifo.h>
 }
 
+class FRunnableThread;
+class FLBRReplayBuffer;
+
 DECLARE_LOG_CATEGORY_EXTERN(LogFFmpegEncodeThread, Log, All);
 
+struct FLBRAVPacketDeleter
+{
+    void operator()(AVPacket* Pkt) const { av_packet_free(&Pkt); }
+};
+typedef TUniquePtr<AVPacket, FLBRAVPacketDeleter> FLBRAVPacketPtr;
+
+// 单个流水线阶段的统计快照
+struct FLBREncodeStageStats
+{
+    int64 Processed = 0;        // 处理的帧 / 包数
+    double BusySeconds = 0.0;   // 累计处理耗时
+    double MaxSeconds = 0.0;    // 单次最长耗时
+    int32 QueueDepth = 0;       // 当前输入队列深度
+    int32 PeakQueueDepth = 0;
+};
+
+// 编码流水线：视频编码、音频编码各一个阶段线程，编码出的包经包队列交给本线程（Run）统一写文件
+// 三者互不阻塞，AAC 编码和磁盘写入可以与 H.264 编码重叠进行
+// 也可以不建线程，交给 FLBREncodeScheduler 的共享工作线程按时间片轮转执行三个阶段
 class LBRUNTIMERECORDER_API FLBRFFmpegEncodeThread : public FRunnable
 {
 public:
@@ -24,7 +54,11 @@ public:
         int32 InWidth,
         int32 InHeight,
         int32 InFPS,
-        const FString& InOutputFile
+        const FString& InOutputFile,
+        const FLBREncodeQueueSettings& InQueueSettings = FLBREncodeQueueSettings(),
+        const FLBRVideoEncoderSettings& InVideoSettings = FLBRVideoEncoderSettings(),
+        const FLBROutputSettings& InOutputSettings = FLBROutputSettings(),
+        const FLBRAudioEncoderSettings& InAudioSettings = FLBRAudioEncoderSettings()
     );
 
     virtual ~FLBRFFmpegEncodeThread();
@@ -34,45 +68,314 @@ public:
     virtual uint32 Run() override;
     virtual void Stop() override;
 
-    void PushFrame(FLBRRawFrame&& Frame);
-    void PushAudioFrame(FLBRAudioFrame&& Frame);
+    // ---- 共享调度器使用，替代 Run ----
+
+    enum class EStage : uint8
+    {
+        Mux,
+        Audio,
+        Video,
+        Num
+    };
+
+    // 需在 Init 前调用：阶段有新工作时额外触发 WakeEvent；VideoSettings 中编码线程数为自动时改用 InCodecThreads
+    void AttachScheduler(FEvent* InWakeEvent, int32 InCodecThreads);
+
+    // 执行某阶段的一个时间片（最多处理 MaxItems 项），返回该阶段是否已结束；同一阶段不能并发调用
+    bool StepStage(EStage Stage, int32 MaxItems, int32& OutProcessed);
+
+    // 三个阶段都结束后调用一次：关闭文件、输出统计并释放 FFmpeg 资源
+    void FinishEncode();
+
+    // 按队列策略入队，返回结果供调用方统计或降级
+    ELBRPushResult PushFrame(FLBRRawFrame&& Frame);
     void StopRecording();
 
+    // 采集端在入队前丢弃的帧（回读环满、后处理队列满），任意线程可调用，重排窗口不再等这个序号
+    void ReportDroppedFrame(int64 Sequence);
+
+    FLBRBoundedQueueStats GetVideoQueueStats() const { return FrameQueue.GetStats(); }
+
+    // 每条源音频轨一个环，音频渲染线程直接写入，录制开始前订阅到 LBSubmixCapture；混音轨没有环
+    int32 GetNumSourceAudioTracks() const { return NumSourceTracks; }
+    FLBRAudioRingPtr GetAudioRing(int32 Track = 0) const { return Track >= 0 && Track < NumSourceTracks ? AudioTracks[Track]->Ring : nullptr; }
+
+    // 编码侧电平表，任意线程可读
+    const FLBRAudioMeter& GetAudioMeter(int32 Track = 0) const { return AudioTracks[FMath::Clamp(Track, 0, NumSourceTracks - 1)]->Meter; }
+
+    // 任意线程可读
+    FLBREncodeStageStats GetVideoStageStats() const { return VideoStage.Snapshot(FrameQueue.Num(), FrameQueue.GetStats().PeakNum); }
+    FLBREncodeStageStats GetAudioStageStats() const;
+    FLBREncodeStageStats GetMuxStageStats() const { return MuxStage.Snapshot(PacketQueue.Num(), PacketQueue.GetStats().PeakNum); }
+
+    // 仅在编码线程结束后读取
+    const FLBRReorderStats& GetReorderStats() const { return ReorderWindow.GetStats(); }
+
+    const FLBRVideoEncoderSettings& GetVideoSettings() const { return VideoSettings; }
+    const FLBROutputSettings& GetOutputSettings() const { return OutputSettings; }
+
+    // 一个分段（或不分段时的整个文件）写完并关闭后调用；旧段在后台线程收尾，最后一段在编码线程上
+    // 预热：以临时文件构造并提前 Init，开始录制时给出正式路径，收尾时改名过去；之后的分段直接写正式路径。
+    // 在推第一帧之前调用；未开始就取消时调用 DiscardOutput，临时文件在收尾时删除且不回调
+    void CommitOutputFile(const FString& InFinalFile);
+    void DiscardOutput() { bDiscardOutput = true; }
+
+    typedef TFunction<void(const FString& FilePath, int32 SegmentIndex)> FOnSegmentFinished;
+
+    // 需在线程启动前设置
+    void SetOnSegmentFinished(FOnSegmentFinished&& InCallback) { OnSegmentFinished = MoveTemp(InCallback); }
+
+    typedef TFunction<void(const FString& FilePath, bool bSuccess)> FOnReplaySaved;
+
+    // 任意线程：把回放缓冲中最近 Seconds 秒的包封装成文件（线程池上执行，不重新编码）
+    // 未开启回放缓冲或尚无关键帧时返回 false
+    bool SaveReplay(const FString& FilePath, float Seconds, FOnReplaySaved&& OnSaved);
+
+    // 写盘延迟与积压，任意线程可读（所有分段累计）
+    FLBRFileWriteStats GetFileWriteStats() const { return FileWriteCounters->Snapshot(); }
+
+    // 因与上一帧相同而跳过编码的帧数
+    int64 GetElidedFrames() const { return ElidedFrames.GetValue(); }
+
+    // 累计分配过的 AVFrame 缓冲数（Init 预分配 + 编码器仍持有引用时的重新分配）
+    int64 GetFramesAllocated() const { return FramesAllocated.GetValue(); }
+
 private:
-    void EncodeOneFrame(const FLBRRawFrame& Frame);
-    void EncodeOneAudioFrame(const FLBRAudioFrame& Frame);
-    void FlushEncoder();
+    // 阶段线程的执行体
+    class FStageRunnable : public FRunnable
+    {
+    public:
+        explicit FStageRunnable(TFunction<void()>&& InBody) : Body(MoveTemp(InBody)) {}
+        virtual uint32 Run() override { Body(); return 0; }
+
+    private:
+        TFunction<void()> Body;
+    };
+
+    struct FStageCounters
+    {
+        FThreadSafeCounter64 Processed;
+        FThreadSafeCounter64 BusyCycles;
+        FThreadSafeCounter64 MaxCycles;   // 只由所属阶段线程写
+
+        void Add(uint64 Cycles);
+
+        FLBREncodeStageStats Snapshot(int32 QueueDepth, int32 PeakQueueDepth) const
+        {
+            FLBREncodeStageStats Stats;
+            Stats.Processed = Processed.GetValue();
+            Stats.BusySeconds = FPlatformTime::ToSeconds64(BusyCycles.GetValue());
+            Stats.MaxSeconds = FPlatformTime::ToSeconds64(MaxCycles.GetValue());
+            Stats.QueueDepth = QueueDepth;
+            Stats.PeakQueueDepth = PeakQueueDepth;
+            return Stats;
+        }
+    };
+
+    // 一个输出文件，时间戳以本段零点为基准
+    struct FSegment
+    {
+        AVFormatContext* FormatCtx = nullptr;
+        FLBRAsyncFileWriterPtr Writer;   // 异步写盘时持有 FormatCtx->pb
+        FLBRKeyframeIndexPtr KeyframeIndex;
+        FString FilePath;
+        int32 Index = 0;
+        int64 VideoOffset = 0;   // 本段零点，视频编码器时间基
+        int64 AudioOffset = 0;   // 同一时刻，音频编码器时间基（各音频轨相同）
+    };
+
+    void RunVideoStage();
+    void RunAudioStage();
+    void JoinStageThreads();
+
+    // 返回阶段是否已结束
+    bool StepVideoStage(int32 MaxItems, int32& OutProcessed);
+    bool StepAudioStage(int32 MaxItems, int32& OutProcessed);
+    bool StepMuxStage(int32 MaxItems, int32& OutProcessed);
+
+    // 把已报告丢弃的序号交给重排窗口并放行就绪的帧
+    void ReleaseReadyFrames();
+
+    // 最多处理 MaxItems 项，返回处理的项数
+    int32 PumpVideo(int32 MaxItems);
+    int32 PumpAudio(int32 MaxItems);
+    int32 PumpMux(int32 MaxItems);
+
+    // 触发阶段事件，挂在调度器上时同时唤醒调度器
+    void Signal(FEvent* StageEvent);
+
+    void EncodeOrderedFrame(FLBRRawFrame& Frame);
+    bool IsDuplicateOfLast(const FLBRRawFrame& Frame) const;
+    int64 ComputeVideoPTS(const FLBRRawFrame& Frame);
+
+    bool IsRolloverDue(int64 PTS);
+
+    FString GetTargetOutputFile() const;
+    FString MakeSegmentPath(const FString& BaseFile, int32 Index) const;
+    bool OpenSegment(FSegment& OutSegment, int32 Index, int64 VideoOffset);
+    void MuxPacket(AVPacket* Pkt);
+    void WriteToSegment(FSegment& InSegment, AVPacket* Pkt);
+    void RollOver(int64 KeyframePTS);
+    // 写 trailer 并关闭文件；bAsync 时在线程池上执行，不阻塞 mux
+    void FinalizeSegment(FSegment& InSegment, bool bAsync);
+    static void CloseSegmentFile(AVFormatContext*& Ctx, FLBRAsyncFileWriterPtr& Writer);
+
+    // 一条音频轨：一个 submix 的环 → 重采样 → 独立的编码器和流；混音轨没有环，输入是各源轨同一块之和
+    struct FAudioTrack
+    {
+        FString Name;
+        FLBRAudioRingPtr Ring;
+        int32 StreamIndex = 0;
+
+        AVCodecContext* CodecCtx = nullptr;
+        AVPacket* Packet = nullptr;
+        int32 FrameSize = 0;              // 每块样本数；PCM 等可变帧长的编码器取固定值
+
+        // 第一块音频到达、知道实际格式后再决定转换方式（InitResampler）：
+        // 格式与编码器完全一致时不建 SwrCtx，直接拷贝；PCM 还跳过编码器直接打包
+        SwrContext* SwrCtx = nullptr;
+        bool bDirectPCM = false;
+        // 采样率不同时重采样输出的样本数不定，先进 FIFO 再按块取
+        AVAudioFifo* Fifo = nullptr;
+        AVFrame* ResampleFrame = nullptr;
+
+        // 块跨越环尾时的拼接缓冲，长度 FrameSize * 声道数
+        TArray<float> Scratch;
+        int32 InputChannels = 0;          // 非零表示输入格式已确定
+
+        // 下一块的 pts（单位：sample），所有轨共用同一零点
+        int64 NextPTS = 0;
+        bool bStarted = false;            // 已按首样本时钟定好起点
+        int64 PendingSilence = 0;         // 读环之前先插入的静音（每声道样本数）
+        int64 PendingSkip = 0;            // 读环之前先丢弃的样本
+        int64 PaddedSamples = 0;
+
+        TArray<AVFrame*> FrameRing;
+        int32 FrameRingIndex = 0;
+
+        // 每块送编码器前统计电平，汇总日志也在音频阶段输出
+        FLBRAudioMeter Meter;
+    };
+
+    void EncodeOneFrame(FLBRRawFrame& Frame);
+    bool OpenAudioTrack(FAudioTrack& Track, const AVCodec* AudioCodec, const AVOutputFormat* OutputFormat);
+    void AlignAudioTrackStarts();
+    int64 GetReadableFrames(const FAudioTrack& Track) const;
+    bool HasAudioBlock(const FAudioTrack& Track) const;
+    void ResampleIntoFifo(FAudioTrack& Track, bool bFlush);
+    // 取一块（静音 / 环或 FIFO 数据，bPadTail 时不足一块补零）编码
+    void EncodeTrackBlock(FAudioTrack& Track, bool bPadTail);
+    void SubmitAudioFrame(FAudioTrack& Track, AVFrame* Frame, bool bHasData);
+    void SubmitPCMPacket(FAudioTrack& Track, const float* Interleaved);
+    void AccumulateDownmix(int64 PTS, const uint8* const* Data);
+    void SendAudioFrame(FAudioTrack& Track, AVFrame* Frame);
+    void EncodeReadyDownmix();
+    bool InitResampler(FAudioTrack& Track, int32 InNumChannels, int32 InSampleRate);
+    void FlushVideoEncoder();
+    void FlushAudioEncoder();
+    AVCodecContext* GetStreamEncoder(int32 StreamIndex) const;
+
+    const AVCodec* FindVideoEncoder() const;
+    const AVCodec* FindAudioEncoder(const AVOutputFormat* OutputFormat) const;
+    void ApplyVideoSettings(AVDictionary** Options) const;
+    void ApplyMuxerOptions(AVDictionary** Options) const;
+
+    // 把编码器吐出的包（编码器时间基）交给 mux 阶段，换算到哪个分段的流时间基由 mux 决定
+    void DrainEncoder(AVCodecContext* Ctx, int32 StreamIndex, AVPacket* Pkt);
+    void LogStageStats(const TCHAR* Name, const FLBREncodeStageStats& Stats) const;
     void Cleanup();
 
+    bool AllocFrameRings();
+    AVFrame* AcquireRingFrame(TArray<AVFrame*>& Ring, int32& RingIndex);
+
 private:
-    AVPacket* Packet = nullptr;
     int32 Width;
     int32 Height;
     int32 FPS;
     FString OutputFile;
+    FString FinalOutputFile;          // 预热时 Init 写 OutputFile（临时文件），开始录制后才确定
+    mutable FCriticalSection OutputFileLock;
+    FThreadSafeBool bDiscardOutput = false;
+    FLBRVideoEncoderSettings VideoSettings;
+    FLBROutputSettings OutputSettings;
+    FLBRAudioEncoderSettings AudioSettings;
+
+    // 有界队列，防止编码跟不上时内存无限增长
+    TLBRBoundedQueue<FLBRRawFrame> FrameQueue;
+    // 后处理线程可能乱序完成，视频阶段按帧号放行
+    TLBRReorderWindow<FLBRRawFrame> ReorderWindow;
+    FCriticalSection DroppedSequencesLock;
+    TArray<int64> DroppedSequences;   // 等视频阶段取走
+    double MaxCaptureLatency = 0.0;   // 发起捕获到开始编码的最长耗时，仅视频阶段写
+
+    // 以下仅视频阶段使用
+    double StartTime = 0.0;           // 可变帧率时间戳的零点，预热时在 CommitOutputFile 中重设
+    int64 LastVideoPTS = -1;
+    uint64 LastPixelHash = 0;
+    FLBRToneLUTPtr LastToneLUT;       // 持有引用，避免已释放的表地址被新表复用
+    int32 ConsecutiveElided = 0;
+    FLBRRawFrame LastElidedFrame;     // 结尾处若是被跳过的重复帧，需补编一帧保住时长
+    FThreadSafeCounter64 ElidedFrames;
+    int64 SegmentStartPTS = 0;
 
-    TQueue<FLBRRawFrame, EQueueMode::Mpsc> FrameQueue;
-    TQueue<FLBRAudioFrame, EQueueMode::Mpsc> AudioQueue;
-    FEvent* FrameEvent = nullptr;
+    // 分段：视频阶段决定在哪一帧切换并强制关键帧，mux 阶段遇到该关键帧时换文件
+    FThreadSafeCounter64 PendingSplitPTS;       // -1 表示没有待执行的切换
+    FThreadSafeBool bSizeRolloverDue = false;   // mux 发现当前段超过大小上限
+    TArray<TFuture<void>> PendingFinalizations; // 后台收尾中的旧段，只在 mux 阶段和 FinishEncode 中访问
+    FOnSegmentFinished OnSegmentFinished;
+
+    // 以下仅 mux 阶段使用
+    FSegment Segment;
+    FSegment ClosingSegment;                    // 切换时刻之前的音频包还要写进旧段
+    int64 DroppedLateAudioPackets = 0;
+    uint64 NewSegmentAudioStreams = 0;          // 已收到新段音频包的流（按流序号置位），全部到齐后旧段收尾
+
+    TSharedPtr<FLBRReplayBuffer, ESPMode::ThreadSafe> ReplayBuffer;
+    FLBRFileWriteCountersPtr FileWriteCounters;
+
+    // 包队列满时阻塞编码阶段，把磁盘写入的背压传回帧队列
+    TLBRBoundedQueue<FLBRAVPacketPtr> PacketQueue;
+
+    FEvent* VideoEvent = nullptr;
+    FEvent* AudioEvent = nullptr;
+    FEvent* MuxEvent = nullptr;
+    FEvent* SchedulerEvent = nullptr;   // 不持有
+
+    FRunnableThread* VideoStageThread = nullptr;
+    FRunnableThread* AudioStageThread = nullptr;
+    FStageRunnable* VideoStageRunnable = nullptr;
+    FStageRunnable* AudioStageRunnable = nullptr;
+
+    FStageCounters VideoStage;
+    FStageCounters AudioStage;
+    FStageCounters MuxStage;
 
     FThreadSafeBool bExit = false;
     FThreadSafeBool bStopAcceptFrame = false;
+    FThreadSafeBool bVideoStageDone = false;
+    FThreadSafeBool bAudioStageDone = false;
 
-    int64 FrameIndex = 0;
+    // FFmpeg，每个分段按同样顺序建流：视频，各源音频轨，混音轨
+    static constexpr int32 VideoStreamIndex = 0;
 
-    // FFmpeg
-    AVFormatContext* FormatCtx = nullptr;
     AVCodecContext* CodecCtx = nullptr;
-    AVStream* VideoStream = nullptr;
     SwsContext* SwsCtx = nullptr;
+    AVPacket* VideoPacket = nullptr;   // 仅视频阶段使用
+
+    // ===== Audio =====（除环和电平表外仅音频阶段使用）
+    TArray<TUniquePtr<FAudioTrack>> AudioTracks;   // 源轨在前，混音轨（若有）在最后
+    int32 NumSourceTracks = 0;
+    FAudioTrack* DownmixTrack = nullptr;
+    bool bAudioClockBaseSet = false;
+    double AudioClockBase = 0.0;                  // 最早开始的轨第一个样本的设备时钟
 
-    // ===== Audio =====
-    AVCodecContext* AudioCodecCtx = nullptr;
-    AVStream* AudioStream = nullptr;
-    SwrContext* SwrCtx = nullptr;
+    // 混音累加环：各源轨转换后的块按块号累加进对应槽（浮点，按编码器的样本布局），最慢的轨也到齐后编码并清零
+    TArray<float> DownmixAccum;
+    int64 DownmixNextPTS = 0;
 
-    // AAC 需要的音频缓存
-    TArray<float> PendingAudioSamples;
-    // 音频 pts（单位：sample）
-    int64 AudioFrameIndex = 0;
+    // 预分配的 AVFrame 环，编码循环内不再 av_frame_alloc / av_frame_get_buffer
+    static constexpr int32 FrameRingSize = 3;
+    TArray<AVFrame*> VideoFrameRing;
+    int32 VideoFrameRingIndex = 0;
+    FThreadSafeCounter64 FramesAllocated;
 };
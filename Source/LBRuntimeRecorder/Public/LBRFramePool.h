@@ -0,0 +1,80 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Templates/RefCounting.h"
+
+class FLBRFramePool;
+
+// 池化的像素缓冲（BGRA），引用计数归零时自动回到所属的 FLBRFramePool
+class LBRUNTIMERECORDER_API FLBRPixelBuffer
+{
+public:
+	FLBRPixelBuffer() = default;
+	FLBRPixelBuffer(const FLBRPixelBuffer&) = delete;
+	FLBRPixelBuffer& operator=(const FLBRPixelBuffer&) = delete;
+
+	TArray<FColor> Pixels;
+
+	// TRefCountPtr 接口
+	uint32 AddRef() const
+	{
+		return uint32(NumRefs.Increment());
+	}
+	uint32 Release() const;
+	uint32 GetRefCount() const
+	{
+		return uint32(NumRefs.GetValue());
+	}
+
+private:
+	friend class FLBRFramePool;
+
+	mutable FThreadSafeCounter NumRefs;
+
+	// 借出期间持有池，保证归还时池仍然有效；空闲时为空，避免循环引用
+	TSharedPtr<FLBRFramePool, ESPMode::ThreadSafe> OwnerPool;
+};
+
+typedef TRefCountPtr<FLBRPixelBuffer> FLBRPixelBufferRef;
+
+struct FLBRFramePoolStats
+{
+	int64 Hits = 0;             // 复用次数
+	int64 Misses = 0;           // 新分配次数（稳定录制时应不再增长）
+	int32 InUse = 0;            // 当前借出
+	int32 HighWaterInUse = 0;   // 借出峰值
+	int32 Pooled = 0;           // 当前空闲
+};
+
+// 线程安全、按像素数分桶的像素缓冲池
+class LBRUNTIMERECORDER_API FLBRFramePool : public TSharedFromThis<FLBRFramePool, ESPMode::ThreadSafe>
+{
+public:
+	explicit FLBRFramePool(int32 InMaxPooledPerSize = 8);
+	~FLBRFramePool();
+
+	// 取一块 Pixels.Num() == NumPixels 的缓冲，内容未初始化；任意线程可调用
+	FLBRPixelBufferRef Acquire(int32 NumPixels);
+
+	FLBRFramePoolStats GetStats() const;
+	int32 GetMaxPooledPerSize() const { return MaxPooledPerSize; }
+
+	// 预先分配 Count 块（不超过每种尺寸的池上限），录制开始后的头几帧不再现分配
+	void Prewarm(int32 NumPixels, int32 Count);
+
+	// 释放所有空闲缓冲
+	void Trim();
+
+private:
+	friend class FLBRPixelBuffer;
+
+	void Recycle(FLBRPixelBuffer* Buffer);
+
+private:
+	mutable FCriticalSection Mutex;
+	TMap<int32, TArray<FLBRPixelBuffer*>> FreeLists;
+	int32 MaxPooledPerSize;
+
+	FLBRFramePoolStats Stats;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FLBRKeyframeIndexEntry
+{
+	int64 TimeUs = 0;       // 相对文件起点的关键帧时间（微秒）
+	int64 ByteOffset = 0;   // 写入该关键帧前的文件位置，是关键帧实际位置的下界
+};
+
+// 录制时随包记录的关键帧索引，分段收尾时存成与媒体文件同名的 .kidx 旁路文件
+// 格式："LBRKIDX1" + 若干个 { int64 TimeUs, int64 ByteOffset }（小端，UE 目标平台均为小端）
+class LBRUNTIMERECORDER_API FLBRKeyframeIndex
+{
+public:
+	static FString GetSidecarPath(const FString& MediaFile);
+
+	void Add(int64 TimeUs, int64 ByteOffset) { Entries.Add({ TimeUs, ByteOffset }); }
+
+	bool Save(const FString& MediaFile) const;
+	bool Load(const FString& MediaFile);
+
+	// 不晚于 TimeUs 的最后一个关键帧，没有时返回 nullptr
+	const FLBRKeyframeIndexEntry* FindAtOrBefore(int64 TimeUs) const;
+
+	int32 Num() const { return Entries.Num(); }
+
+private:
+	TArray<FLBRKeyframeIndexEntry> Entries;
+};
+
+typedef TSharedPtr<FLBRKeyframeIndex, ESPMode::ThreadSafe> FLBRKeyframeIndexPtr;
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/ThreadSafeCounter64.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogLBRProcessingPool, Log, All);
+
+// 回读后处理阶段：固定数量的常驻线程 + 有界任务队列
+// 队列满时不会新开线程，由调用方选择等待（背压）或丢弃
+class LBRUNTIMERECORDER_API FLBRProcessingPool
+{
+public:
+	FLBRProcessingPool(int32 InNumWorkers, int32 InQueueCapacity, const TCHAR* InName = TEXT("LBR_Processing"));
+	~FLBRProcessingPool();
+
+	// 队列满时 bWaitWhenFull 为 true 则阻塞到有空位，否则返回 false 并计入 Rejected
+	bool Enqueue(TUniqueFunction<void()>&& Task, bool bWaitWhenFull = false);
+
+	// 处理完已入队的任务后停止全部线程
+	void Shutdown();
+
+	int32 GetNumWorkers() const { return Workers.Num(); }
+	int32 GetQueueCapacity() const { return Capacity; }
+	int32 GetQueueDepth() const;
+	int32 GetPeakQueueDepth() const;
+	int64 GetRejectedCount() const { return Rejected.GetValue(); }
+
+private:
+	class FWorker : public FRunnable
+	{
+	public:
+		explicit FWorker(FLBRProcessingPool& InOwner) : Owner(InOwner) {}
+		virtual uint32 Run() override;
+
+	private:
+		FLBRProcessingPool& Owner;
+	};
+
+	bool Dequeue(TUniqueFunction<void()>& OutTask);
+
+private:
+	mutable FCriticalSection Mutex;
+	TArray<TUniqueFunction<void()>> Queue;   // 环形缓冲，长度固定为 Capacity
+	int32 Head = 0;
+	int32 Count = 0;
+	int32 PeakCount = 0;
+	int32 Capacity = 0;
+
+	FEvent* WorkEvent = nullptr;
+	FEvent* SpaceEvent = nullptr;
+
+	TArray<FWorker*> Workers;
+	TArray<FRunnableThread*> Threads;
+
+	FThreadSafeBool bStopping = false;
+	FThreadSafeCounter64 Rejected;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "HAL/ThreadSafeCounter64.h"
+
+class FRHIGPUTextureReadback;
+class FRHITexture;
+class FRHICommandListImmediate;
+
+DECLARE_LOG_CATEGORY_EXTERN(LogLBRReadbackRing, Log, All);
+
+// 固定数量、常驻的 GPU 回读槽，只在渲染线程上使用
+// 每次捕获占用下一个空闲槽，渲染线程每帧按提交顺序收割一次已完成的槽，不睡眠也不重复创建回读对象
+class LBRUNTIMERECORDER_API FLBRReadbackRing
+{
+public:
+	// 数据在回调期间有效（回读缓冲处于 Lock 状态）；RowPitch 以像素为单位
+	typedef TUniqueFunction<void(const void* Data, int32 RowPitchInPixels, int32 Height)> FOnReadbackReady;
+
+	explicit FLBRReadbackRing(int32 InNumSlots);
+	~FLBRReadbackRing();
+
+	// 渲染线程：环满时不等待，返回 false 并计入丢弃
+	bool Enqueue(FRHICommandListImmediate& RHICmdList, FRHITexture* SourceTexture, FOnReadbackReady&& OnReady);
+
+	// 渲染线程：收割所有已完成的槽
+	void Harvest();
+
+	// 以下任意线程可读
+	int32 GetNumSlots() const { return NumSlots; }
+	int32 GetNumInFlight() const { return NumInFlight.GetValue(); }
+	int64 GetDroppedCount() const { return Dropped.GetValue(); }
+
+private:
+	struct FSlot
+	{
+		TUniquePtr<FRHIGPUTextureReadback> Readback;
+		FOnReadbackReady OnReady;
+	};
+
+	TArray<FSlot> Slots;
+	int32 NumSlots = 0;
+	int32 Head = 0;   // 最早提交、尚未收割的槽
+
+	FThreadSafeCounter NumInFlight;
+	FThreadSafeCounter64 Dropped;
+};
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FLBRReorderStats
+{
+	int64 Released = 0;
+	int64 OutOfOrder = 0;   // 到达时前面还有未到的帧
+	int64 Skipped = 0;      // 窗口满时放弃等待的序号（上游已丢弃的帧）
+	int64 Late = 0;         // 已被跳过后才到达，直接丢弃
+	int64 Dropped = 0;      // 上游报告已丢弃的序号，不必等窗口满
+	int32 PeakPending = 0;
+};
+
+// 按序号严格递增放行的重排窗口，单线程使用
+// 等待中的项超过窗口大小时认为缺失的序号已被上游丢弃，跳到最小的已到序号继续
+template<typename T>
+class TLBRReorderWindow
+{
+public:
+	explicit TLBRReorderWindow(int32 InWindowSize, int64 InFirstSequence = 0)
+		: WindowSize(FMath::Max(1, InWindowSize))
+		, NextSequence(InFirstSequence)
+	{
+		Pending.Reserve(WindowSize + 1);
+	}
+
+	// 返回 false 表示该项来得太晚，已被丢弃
+	bool Insert(int64 Sequence, T&& Item)
+	{
+		if (Sequence < NextSequence)
+		{
+			Stats.Late++;
+			return false;
+		}
+
+		if (Sequence != NextSequence)
+		{
+			Stats.OutOfOrder++;
+		}
+
+		// 窗口很小，插入排序即可
+		int32 Index = Pending.Num();
+		while (Index > 0 && Pending[Index - 1].Sequence > Sequence)
+		{
+			--Index;
+		}
+		Pending.Insert(FEntry{ Sequence, MoveTemp(Item) }, Index);
+		Stats.PeakPending = FMath::Max(Stats.PeakPending, Pending.Num());
+		return true;
+	}
+
+	// 上游确定不会再来的序号，轮到它时直接跳过
+	void MarkDropped(int64 Sequence)
+	{
+		if (Sequence < NextSequence)
+		{
+			return;
+		}
+
+		int32 Index = Dropped.Num();
+		while (Index > 0 && Dropped[Index - 1] > Sequence)
+		{
+			--Index;
+		}
+		Dropped.Insert(Sequence, Index);
+	}
+
+	// 取出下一个可以放行的项
+	bool PopReady(T& OutItem)
+	{
+		SkipDropped();
+
+		if (Pending.Num() == 0)
+		{
+			return false;
+		}
+
+		if (Pending[0].Sequence != NextSequence)
+		{
+			if (Pending.Num() <= WindowSize)
+			{
+				return false;
+			}
+			Stats.Skipped += Pending[0].Sequence - NextSequence;
+		}
+
+		return PopFront(OutItem);
+	}
+
+	// 结束时忽略缺口，按序放出剩余全部项
+	bool PopAny(T& OutItem)
+	{
+		if (Pending.Num() == 0)
+		{
+			return false;
+		}
+
+		Stats.Skipped += Pending[0].Sequence - NextSequence;
+		return PopFront(OutItem);
+	}
+
+	int32 NumPending() const { return Pending.Num(); }
+	const FLBRReorderStats& GetStats() const { return Stats; }
+
+private:
+	struct FEntry
+	{
+		int64 Sequence;
+		T Item;
+	};
+
+	void SkipDropped()
+	{
+		while (Dropped.Num() > 0 && Dropped[0] <= NextSequence)
+		{
+			if (Dropped[0] == NextSequence)
+			{
+				NextSequence++;
+				Stats.Dropped++;
+			}
+			Dropped.RemoveAt(0, 1, EAllowShrinking::No);
+		}
+	}
+
+	bool PopFront(T& OutItem)
+	{
+		NextSequence = Pending[0].Sequence + 1;
+		OutItem = MoveTemp(Pending[0].Item);
+		Pending.RemoveAt(0, 1, EAllowShrinking::No);
+		Stats.Released++;
+		return true;
+	}
+
+private:
+	TArray<FEntry> Pending;
+	TArray<int64> Dropped;   // 升序
+	int32 WindowSize;
+	int64 NextSequence;
+
+	FLBRReorderStats Stats;
+};
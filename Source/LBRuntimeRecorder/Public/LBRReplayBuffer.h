@@ -0,0 +1,71 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Deque.h"
+#include "Misc/ScopeLock.h"
+#include "LBRFFmpegEncodeThread.h"
+
+// 即时回放：在内存中保留最近一段已编码的包（只增引用，不拷贝数据），按 GOP 整体淘汰
+// mux 阶段写入，任意线程取快照后在线程池上直接封装成文件，不重新编码
+class LBRUNTIMERECORDER_API FLBRReplayBuffer : public TSharedFromThis<FLBRReplayBuffer, ESPMode::ThreadSafe>
+{
+public:
+	typedef TFunction<void(const FString& FilePath, bool bSuccess)> FOnReplaySaved;
+
+	FLBRReplayBuffer(double InMaxSeconds, int64 InMaxBytes);
+	~FLBRReplayBuffer();
+
+	// 开始写入前按流序号依次登记；第一个视频流决定关键帧对齐
+	void AddStream(const AVCodecContext* Encoder);
+
+	// mux 阶段：Pkt 为编码器时间基，stream_index 与登记顺序一致
+	void Add(const AVPacket* Pkt);
+
+	// 任意线程：取最近 Seconds 秒（从不晚于起点的关键帧开始）写成文件，完成后在线程池上回调
+	bool SaveAsync(const FString& FilePath, const char* MuxerName, double Seconds, FOnReplaySaved&& OnSaved);
+
+	double GetBufferedSeconds() const;
+	int64 GetBufferedBytes() const;
+	int64 GetEvictedPackets() const;
+
+private:
+	struct FEntry
+	{
+		FLBRAVPacketPtr Packet;
+		double Time = 0.0;    // pts 换算成秒
+		int64 Serial = 0;     // 入队序号
+	};
+
+	struct FKeyframe
+	{
+		double Time = 0.0;
+		int64 Serial = 0;
+	};
+
+	struct FStreamInfo
+	{
+		AVCodecParameters* Params = nullptr;
+		AVRational TimeBase = { 0, 1 };
+	};
+
+	// 调用方持有 Mutex
+	void Evict();
+
+	static bool WriteFile(const FString& FilePath, const char* MuxerName, const TArray<FStreamInfo>& Streams, TArray<FLBRAVPacketPtr>& Packets, const TArray<int64>& Offsets);
+
+	double MaxSeconds;
+	int64 MaxBytes;
+
+	TArray<FStreamInfo> Streams;
+	int32 VideoStreamIndex = INDEX_NONE;
+
+	mutable FCriticalSection Mutex;
+	TDeque<FEntry> Entries;
+	TDeque<FKeyframe> Keyframes;
+	int64 NextSerial = 0;
+	int64 Bytes = 0;
+	double NewestTime = 0.0;
+	int64 Evicted = 0;
+};
+
+typedef TSharedPtr<FLBRReplayBuffer, ESPMode::ThreadSafe> FLBRReplayBufferPtr;
@@ -4,8 +4,12 @@
 
 #include "CoreMinimal.h"
 #include "UObject/NoExportTypes.h"
+#include "LBRColorCorrection.h"
+#include "LBRFramePool.h"
 #include "LBRTypes.generated.h"
 
+class USoundSubmix;
+
 /**
  * 
  */
@@ -20,20 +24,317 @@ enum class ELBRVideoResolution : uint8
 	Resolution_1440p2K   UMETA(DisplayName = "1440p 2K (2560x1440)")
 };
 
-struct FLBRRawFrame
+// 编码队列满时的处理方式
+UENUM(BlueprintType)
+enum class ELBRQueueFullPolicy : uint8
 {
-	TArray<FColor> Pixels;   // UE ReadPixels 得到的 FColor
-	int32 Width = 0;
-	int32 Height = 0;
-	int64 PTS = 0;
+	BlockProducer   UMETA(DisplayName = "阻塞生产者"),
+	DropOldest      UMETA(DisplayName = "丢弃最旧"),
+	DropNewest      UMETA(DisplayName = "丢弃最新"),
+	NeverDrop       UMETA(DisplayName = "从不丢弃（超限只计数）")
+};
+
+// 编码队列上限与策略
+USTRUCT(BlueprintType)
+struct FLBREncodeQueueSettings
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encode Queue", meta = (DisplayName = "视频队列帧数上限", ClampMin = "1"))
+	int32 MaxVideoFrames = 8;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encode Queue", meta = (DisplayName = "视频队列内存上限(MB)", ClampMin = "1"))
+	int32 MaxVideoMegabytes = 256;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encode Queue", meta = (DisplayName = "视频队列满时"))
+	ELBRQueueFullPolicy VideoPolicy = ELBRQueueFullPolicy::DropOldest;
+
+	// 音频线程到编码器的无锁环容量；音频线程不能阻塞，写满时丢弃新样本并计数
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encode Queue", meta = (DisplayName = "音频缓冲时长(秒)", ClampMin = "0.1", ClampMax = "30"))
+	float AudioBufferSeconds = 5.f;
+
+	// 编码前按帧号重排，等待中的帧超过该数量时跳过缺失的帧号
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encode Queue", meta = (DisplayName = "乱序重排窗口(帧)", ClampMin = "1", ClampMax = "64"))
+	int32 ReorderWindow = 8;
 };
 
-struct FLBRAudioFrame
+// 视频编码器预设
+UENUM(BlueprintType)
+enum class ELBRVideoEncoderPreset : uint8
+{
+	Custom          UMETA(DisplayName = "自定义"),
+	LowCPU          UMETA(DisplayName = "低 CPU 占用"),
+	ArchiveQuality  UMETA(DisplayName = "存档画质"),
+	LowLatency      UMETA(DisplayName = "低延迟")
+};
+
+UENUM(BlueprintType)
+enum class ELBRRateControlMode : uint8
+{
+	CRF             UMETA(DisplayName = "恒定质量 (CRF)"),
+	Bitrate         UMETA(DisplayName = "目标码率 (VBV)")
+};
+
+// 视频编码器参数，字符串选项原样交给 FFmpeg，编码器不认识的选项只打警告
+USTRUCT(BlueprintType)
+struct FLBRVideoEncoderSettings
 {
-	TArray<float> Samples;   // interleaved
-	int32 NumChannels;
-	int32 SampleRate;
-	int64 PTS;               // 样本级时间戳
+	GENERATED_BODY()
+
+	// libx264 / libx265 / libvpx-vp9 / libsvtav1 等，找不到时回退到默认 H.264 编码器
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Encoder", meta = (DisplayName = "编码器"))
+	FString EncoderName = TEXT("libx264");
+
+	// x264 / x265 用 ultrafast ~ veryslow，libsvtav1 用数字 0 ~ 13
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Encoder", meta = (DisplayName = "编码预设 (preset)"))
+	FString Preset = TEXT("ultrafast");
+
+	// 如 zerolatency / film，留空不设置
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Encoder", meta = (DisplayName = "调优 (tune)"))
+	FString Tune;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Encoder", meta = (DisplayName = "码率控制"))
+	ELBRRateControlMode RateControl = ELBRRateControlMode::CRF;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Encoder", meta = (DisplayName = "CRF", ClampMin = "0", ClampMax = "63", EditCondition = "RateControl == ELBRRateControlMode::CRF"))
+	int32 CRF = 23;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Encoder", meta = (DisplayName = "目标码率(kbps)", ClampMin = "100", EditCondition = "RateControl == ELBRRateControlMode::Bitrate"))
+	int32 TargetBitrateKbps = 8000;
+
+	// 0 表示与目标码率相同
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Encoder", meta = (DisplayName = "最大码率(kbps)", ClampMin = "0", EditCondition = "RateControl == ELBRRateControlMode::Bitrate"))
+	int32 MaxBitrateKbps = 0;
+
+	// VBV 缓冲，0 表示取最大码率的 2 倍
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Encoder", meta = (DisplayName = "VBV 缓冲(kbit)", ClampMin = "0", EditCondition = "RateControl == ELBRRateControlMode::Bitrate"))
+	int32 BufferSizeKbits = 0;
+
+	// 关键帧间隔（帧），0 表示 1 秒
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Encoder", meta = (DisplayName = "GOP 长度", ClampMin = "0"))
+	int32 GOPLength = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Encoder", meta = (DisplayName = "B 帧数", ClampMin = "0", ClampMax = "16"))
+	int32 MaxBFrames = 0;
+
+	// 0 表示由编码器自动决定
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Encoder", meta = (DisplayName = "编码线程数", ClampMin = "0", ClampMax = "64"))
+	int32 ThreadCount = 0;
+
+	// 片级多线程延迟更低，帧级多线程吞吐更高
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Encoder", meta = (DisplayName = "片级多线程"))
+	bool bSliceThreads = false;
+
+	// 按真实捕获时间打时间戳（时间基 1/90000），否则按帧号（时间基 1/帧率）
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Encoder", meta = (DisplayName = "可变帧率"))
+	bool bVariableFrameRate = false;
+
+	// 与上一帧像素完全相同的帧不再编码，由上一帧延长显示
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Encoder", meta = (DisplayName = "跳过重复帧"))
+	bool bSkipDuplicateFrames = false;
+
+	static FLBRVideoEncoderSettings FromPreset(ELBRVideoEncoderPreset InPreset);
+};
+
+// 单声道电平，取自编码侧最近一块音频（约 20ms）
+USTRUCT(BlueprintType)
+struct FLBRAudioChannelLevel
+{
+	GENERATED_BODY()
+
+	// 线性幅度，满刻度为 1
+	UPROPERTY(BlueprintReadOnly, Category = "Audio Level", meta = (DisplayName = "峰值"))
+	float Peak = 0.f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Audio Level", meta = (DisplayName = "均方根"))
+	float RMS = 0.f;
+
+	// dBFS，静音时为 -100
+	UPROPERTY(BlueprintReadOnly, Category = "Audio Level", meta = (DisplayName = "峰值(dBFS)"))
+	float PeakDb = -100.f;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Audio Level", meta = (DisplayName = "均方根(dBFS)"))
+	float RMSDb = -100.f;
+};
+
+// 输出容器
+UENUM(BlueprintType)
+enum class ELBRContainerFormat : uint8
+{
+	MP4             UMETA(DisplayName = "MP4"),
+	FragmentedMP4   UMETA(DisplayName = "分片 MP4（崩溃安全）"),
+	Matroska        UMETA(DisplayName = "Matroska (.mkv)"),
+	MPEGTS          UMETA(DisplayName = "MPEG-TS (.ts)"),
+	QuickTime       UMETA(DisplayName = "QuickTime (.mov)")
+};
+
+// 输出文件设置
+USTRUCT(BlueprintType)
+struct FLBROutputSettings
+{
+	GENERATED_BODY()
+
+	// 普通 MP4 的索引停止时才写入，中途崩溃整个文件不可读，且索引随时长常驻内存
+	// 分片 MP4 在每个关键帧处落一个分片，MKV / TS 边写边可播，停止时只补很小的尾部
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Output", meta = (DisplayName = "容器格式"))
+	ELBRContainerFormat ContainerFormat = ELBRContainerFormat::MP4;
+
+	// 到时长后在下一帧强制关键帧并切换到新文件，编码器不重启、不丢帧；0 表示不按时长分段
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Output", meta = (DisplayName = "分段时长(分钟)", ClampMin = "0"))
+	float SegmentMinutes = 0.f;
+
+	// 当前文件超过该大小后切换，0 表示不按大小分段
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Output", meta = (DisplayName = "分段大小(MB)", ClampMin = "0"))
+	int32 SegmentMegabytes = 0;
+
+	// 写文件经预分配的缓冲交给专用写线程，磁盘卡顿不再直接卡住 mux 和编码
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Output", meta = (DisplayName = "异步写盘"))
+	bool bWriteBehindIO = true;
+
+	// 写盘缓冲总大小，按 1MB 一块在途；写满时 mux 等待
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Output", meta = (DisplayName = "写盘缓冲(MB)", ClampMin = "2", ClampMax = "1024", EditCondition = "bWriteBehindIO"))
+	int32 WriteBufferMegabytes = 32;
+
+	// 整块写入绕过页缓存（仅 Linux，文件系统不支持时自动回退）
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Output", meta = (DisplayName = "直接 I/O (Linux)", EditCondition = "bWriteBehindIO"))
+	bool bDirectIO = false;
+
+	// 在内存中保留最近这么多秒的已编码包，可随时 SaveReplay 存成文件；0 表示关闭
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Output", meta = (DisplayName = "回放缓冲时长(秒)", ClampMin = "0", ClampMax = "3600"))
+	float ReplayBufferSeconds = 0.f;
+
+	// 超出后提前淘汰最旧的 GOP
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Output", meta = (DisplayName = "回放缓冲内存上限(MB)", ClampMin = "1", EditCondition = "ReplayBufferSeconds > 0"))
+	int32 ReplayBufferMegabytes = 256;
+
+	// 只保留回放缓冲，不写录制文件
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Output", meta = (DisplayName = "仅回放缓冲", EditCondition = "ReplayBufferSeconds > 0"))
+	bool bReplayBufferOnly = false;
+
+	// 每个输出文件旁写一份 .kidx 关键帧索引，供 ExtractClip 快速定位
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Output", meta = (DisplayName = "写关键帧索引"))
+	bool bWriteKeyframeIndex = true;
+
+	// 含点，如 ".mp4"
+	FString GetFileExtension() const;
+
+	// 分段时文件名追加 _000、_001 …
+	bool IsSegmented() const { return SegmentMinutes > 0.f || SegmentMegabytes > 0; }
+};
+
+// 音频编码格式；容器不支持所选格式时回退到 AAC
+UENUM(BlueprintType)
+enum class ELBRAudioCodec : uint8
+{
+	AAC             UMETA(DisplayName = "AAC"),
+	Opus            UMETA(DisplayName = "Opus"),
+	FLAC            UMETA(DisplayName = "FLAC（无损）"),
+	PCM             UMETA(DisplayName = "PCM 32 位浮点（MKV / MOV）")
+};
+
+// 一条音频轨对应一个 submix
+USTRUCT(BlueprintType)
+struct FLBRAudioTrackSettings
+{
+	GENERATED_BODY()
+
+	// 写入容器的轨道标题，为空时用 "Track N"
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Audio", meta = (DisplayName = "轨道名"))
+	FString Name;
+
+	// 为空时录制主 submix
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Audio", meta = (DisplayName = "Submix"))
+	USoundSubmix* Submix = nullptr;
+};
+
+USTRUCT(BlueprintType)
+struct FLBRAudioEncoderSettings
+{
+	GENERATED_BODY()
+
+	// 每个 submix 编码成独立的音频流，所有轨使用同一个按样本计的时间零点；为空时只录一条轨
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Audio", meta = (DisplayName = "音频轨", TitleProperty = "Name"))
+	TArray<FLBRAudioTrackSettings> Tracks;
+
+	// 额外写一条各轨相加的混音轨，作为默认播放的音轨
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Audio", meta = (DisplayName = "混音轨"))
+	bool bDownmixTrack = false;
+
+	// PCM 与设备格式一致时直接打包写入，不经过编码器
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Audio", meta = (DisplayName = "编码格式"))
+	ELBRAudioCodec Codec = ELBRAudioCodec::AAC;
+
+	// 编码采样率与声道数；设备格式不同时重采样、按标准布局做声道映射，Opus 固定 48kHz
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Audio", meta = (DisplayName = "采样率", ClampMin = "8000", ClampMax = "192000"))
+	int32 SampleRate = 48000;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Audio", meta = (DisplayName = "声道数", ClampMin = "1", ClampMax = "8"))
+	int32 NumChannels = 2;
+
+	// 每条轨的码率，仅对有损格式有效
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Audio", meta = (DisplayName = "码率(kbps)", ClampMin = "32", ClampMax = "512", EditCondition = "Codec == ELBRAudioCodec::AAC || Codec == ELBRAudioCodec::Opus"))
+	int32 BitrateKbps = 128;
+
+	// 为空时录主输出一条轨；最多 8 条
+	int32 GetNumSourceTracks() const { return FMath::Clamp(Tracks.Num(), 1, 8); }
+};
+
+UENUM(BlueprintType)
+enum class ELBREncodeThreadPriority : uint8
+{
+	Lowest          UMETA(DisplayName = "最低"),
+	BelowNormal     UMETA(DisplayName = "低于正常"),
+	Normal          UMETA(DisplayName = "正常"),
+	AboveNormal     UMETA(DisplayName = "高于正常")
+};
+
+// 多个录制器共用的编码工作线程池
+USTRUCT(BlueprintType)
+struct FLBREncodeSchedulerSettings
+{
+	GENERATED_BODY()
+
+	// 0 表示取物理核数的一半（至少 1）
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encode Scheduler", meta = (DisplayName = "工作线程数", ClampMin = "0", ClampMax = "64"))
+	int32 NumWorkers = 0;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encode Scheduler", meta = (DisplayName = "线程优先级"))
+	ELBREncodeThreadPriority Priority = ELBREncodeThreadPriority::BelowNormal;
+
+	// 按位指定可用的逻辑核，0 表示不限制
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encode Scheduler", meta = (DisplayName = "核心亲和掩码"))
+	int64 AffinityMask = 0;
+
+	// 编码参数里线程数为自动时，每个会话的 H.264 编码器使用的线程数；1 表示只在工作线程上编码，总 CPU 即工作线程数
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encode Scheduler", meta = (DisplayName = "每会话编码线程数", ClampMin = "1", ClampMax = "16"))
+	int32 CodecThreadsPerSession = 1;
+
+	// 每次轮到一个会话的视频阶段时最多编码的帧数，越小各会话越公平
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encode Scheduler", meta = (DisplayName = "视频时间片(帧)", ClampMin = "1", ClampMax = "16"))
+	int32 VideoFramesPerSlice = 1;
+};
+
+// 推入编码队列的结果
+enum class ELBRPushResult : uint8
+{
+	Queued,
+	QueuedAfterBlocking,   // 等到空位后入队
+	QueuedDroppedOldest,   // 入队，但挤掉了最旧的一项
+	QueuedOverCap,         // NeverDrop 策略下超限入队
+	DroppedNewest,         // 本项被丢弃
+	Rejected               // 已停止接收
+};
+
+struct FLBRRawFrame
+{
+	FLBRPixelBufferRef Buffer;   // 池化的 FColor（BGRA），编码线程转换完即归还
+	FLBRToneLUTPtr ToneLUT;      // 调色在转 YUV 时一并完成
+	int32 Width = 0;
+	int32 Height = 0;
+	int64 PTS = 0;               // 发起捕获时分配，编码器时间基 1/FPS
+	int64 Sequence = 0;          // 捕获序号，连续递增，编码前按它重排
+	double CaptureTime = 0.0;    // 发起捕获时的 FPlatformTime::Seconds()
+	uint64 PixelHash = 0;        // 后处理线程算出的像素哈希，0 表示未计算
 };
 
 UCLASS()
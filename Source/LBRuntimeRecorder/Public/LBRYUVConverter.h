@@ -0,0 +1,28 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FLBRToneLUT;
+
+// YUV420P 三个平面的目标地址（通常直接指向编码器的 AVFrame）
+struct FLBRYUV420Planes
+{
+	uint8* Y = nullptr;
+	uint8* U = nullptr;
+	uint8* V = nullptr;
+	int32 YStride = 0;
+	int32 UStride = 0;
+	int32 VStride = 0;
+};
+
+// 单遍 BGRA(FColor) -> YUV420P（BT.601 limited range），可顺带查表调色
+// 两行一组处理，每组按列分块：先查表到栈上的小块缓存，再从缓存转换，整帧只读一次
+class LBRUNTIMERECORDER_API FLBRYUVConverter
+{
+public:
+	// SrcStride 以像素为单位（回读的行距可能大于宽度）；LUT 可为空；bParallel 时按行带分给任务线程
+	static void Convert(const FColor* Src, int32 SrcStride, int32 Width, int32 Height, const FLBRToneLUT* LUT, const FLBRYUV420Planes& Dst, bool bParallel = true);
+
+	// 纯标量参考实现，SIMD 版本需与其逐位一致
+	static void ConvertReference(const FColor* Src, int32 SrcStride, int32 Width, int32 Height, const FLBRToneLUT* LUT, const FLBRYUV420Planes& Dst);
+};
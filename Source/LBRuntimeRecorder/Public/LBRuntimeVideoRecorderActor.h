@@ -4,13 +4,31 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "LBRColorCorrection.h"
 #include "LBRFFmpegEncodeThread.h"
+#include "LBRProcessingPool.h"
+#include "LBRReadbackRing.h"
 #include "LBRTypes.h"
 #include "LBSubmixCapture.h"
 #include "LBRuntimeVideoRecorderActor.generated.h"
 
+class ULBREncodeSchedulerSubsystem;
+class USoundSubmix;
+
 DECLARE_LOG_CATEGORY_EXTERN(LogLBRuntimeVideoRecorder, Log, All);
 
+// 一帧处理完并交给编码队列后在游戏线程通知；bQueued 为 false 表示该帧被队列策略丢弃
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FLBROnFrameQueued, int64, FrameNumber, bool, bQueued);
+
+// 一个输出文件写完并关闭后在游戏线程通知，此后可以安全地上传或删除该文件
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FLBROnSegmentFinished, const FString&, FilePath, int32, SegmentIndex);
+
+// SaveReplay 写完文件后在游戏线程通知
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FLBROnReplaySaved, const FString&, FilePath, bool, bSuccess);
+
+// ExtractClip 写完片段后在游戏线程通知
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FLBROnClipExtracted, const FString&, FilePath, bool, bSuccess);
+
 UCLASS()
 class LBRUNTIMERECORDER_API ALBRuntimeVideoRecorderActor : public AActor
 {
@@ -37,6 +55,59 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Recorder", meta = (DisplayName = "帧率", ClampMin = "1", ClampMax = "120"))
 	float CaptureFPS = 60.f;
 
+	// 回读后处理的常驻线程数（开始录制时生效）
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Recorder", meta = (DisplayName = "后处理线程数", ClampMin = "1", ClampMax = "16"))
+	int32 ProcessingWorkerCount = 2;
+
+	// 后处理队列上限，满了丢弃新回读的帧而不是再开线程
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Recorder", meta = (DisplayName = "后处理队列长度", ClampMin = "1", ClampMax = "64"))
+	int32 ProcessingQueueCapacity = 8;
+
+	// 常驻的 GPU 回读槽数量，全部在途时新的捕获直接丢弃
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Recorder", meta = (DisplayName = "回读槽数量", ClampMin = "2", ClampMax = "8"))
+	int32 ReadbackRingSize = 3;
+
+	// 视频编码器预设，选“自定义”时使用下面的编码参数（开始录制时生效）
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Recorder", meta = (DisplayName = "编码器预设"))
+	ELBRVideoEncoderPreset VideoEncoderPreset = ELBRVideoEncoderPreset::Custom;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Recorder", meta = (DisplayName = "编码参数", EditCondition = "VideoEncoderPreset == ELBRVideoEncoderPreset::Custom"))
+	FLBRVideoEncoderSettings VideoEncoderSettings;
+
+	// 编码队列上限与满时策略（开始录制时生效）
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Recorder", meta = (DisplayName = "编码队列"))
+	FLBREncodeQueueSettings EncodeQueueSettings;
+
+	// 容器格式决定文件扩展名（开始录制时生效）
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Recorder", meta = (DisplayName = "输出设置"))
+	FLBROutputSettings OutputSettings;
+
+	// 编码交给进程共享的工作线程池（ULBREncodeSchedulerSubsystem），多个录制器时不再各开一组编码线程
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Recorder", meta = (DisplayName = "使用共享编码线程池"))
+	bool bUseSharedEncodeScheduler = true;
+
+	// 为空时录制主 submix；音频设置里配置了多条轨时以各轨的 Submix 为准
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Recorder", meta = (DisplayName = "录制的 Submix"))
+	USoundSubmix* CaptureSubmix = nullptr;
+
+	// 分轨录制（对白 / 音乐 / 音效各一条）与混音轨（开始录制时生效）
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Video Recorder", meta = (DisplayName = "音频设置"))
+	FLBRAudioEncoderSettings AudioSettings;
+
+	// 仅在有绑定时才回到游戏线程通知，像素不经过游戏线程
+	UPROPERTY(BlueprintAssignable, Category = "LBRuntimeVideoRecorder | Video Recorder")
+	FLBROnFrameQueued OnFrameQueued;
+
+	// 分段录制时每切换一次触发一次，停止录制时最后一段也会触发
+	UPROPERTY(BlueprintAssignable, Category = "LBRuntimeVideoRecorder | Video Recorder")
+	FLBROnSegmentFinished OnSegmentFinished;
+
+	UPROPERTY(BlueprintAssignable, Category = "LBRuntimeVideoRecorder | Video Recorder")
+	FLBROnReplaySaved OnReplaySaved;
+
+	UPROPERTY(BlueprintAssignable, Category = "LBRuntimeVideoRecorder | Video Recorder")
+	FLBROnClipExtracted OnClipExtracted;
+
 	virtual void OnConstruction(const FTransform& Transform) override;
 	virtual void BeginPlay() override;
 #if WITH_EDITOR
@@ -45,15 +116,43 @@ public:
 	virtual void Tick(float DeltaTime) override;
 	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
+	// 在后台提前打开编码器、预开临时输出文件并预分配像素缓冲，之后 StartRecording 只切换状态，第一帧立即进入编码。
+	// 编码、输出与音频设置以预热时为准；停止录制时临时文件改名为正式文件名
+	UFUNCTION(BlueprintCallable, Category = "LBRuntimeVideoRecorder | Video Recorder")
+	void ArmRecorder();
+
+	// 取消预热，删除临时文件；已开始录制时无效
+	UFUNCTION(BlueprintCallable, Category = "LBRuntimeVideoRecorder | Video Recorder")
+	void DisarmRecorder();
+
+	UFUNCTION(BlueprintPure, Category = "LBRuntimeVideoRecorder | Video Recorder")
+	bool IsArmed() const { return bIsArmed; }
+
 	UFUNCTION(BlueprintCallable, Category = "LBRuntimeVideoRecorder | Video Recorder")
 	void StartRecording(const FString& FileName = "Output");
 
 	UFUNCTION(BlueprintCallable, Category = "LBRuntimeVideoRecorder | Video Recorder")
 	void StopRecording();
 
+	// 把回放缓冲里最近 Seconds 秒存到录像目录，需在录制中且开启了回放缓冲；结果经 OnReplaySaved 通知
+	UFUNCTION(BlueprintCallable, Category = "LBRuntimeVideoRecorder | Video Recorder")
+	bool SaveReplay(const FString& FileName = "Replay", float Seconds = 30.f);
+
+	// 从已写完的录像文件（如 OnSegmentFinished 给出的路径）中流拷贝截取一段存到录像目录，后台执行，结果经 OnClipExtracted 通知
+	UFUNCTION(BlueprintCallable, Category = "LBRuntimeVideoRecorder | Video Recorder")
+	void ExtractClip(const FString& SourceFile, float StartSeconds, float EndSeconds, const FString& FileName = "Clip");
+
 	UFUNCTION(BlueprintCallable, Category = "LBRuntimeVideoRecorder| Scene Shot")
 	void SceneShot(const FString& FileName = "SceneShot");
 
+	// 后处理队列当前积压的帧数
+	UFUNCTION(BlueprintPure, Category = "LBRuntimeVideoRecorder| Utils")
+	int32 GetProcessingQueueDepth() const;
+
+	// 录制中某条源音频轨各声道的当前电平，可直接驱动 VU 表；未录制或尚无音频时返回空数组
+	UFUNCTION(BlueprintPure, Category = "LBRuntimeVideoRecorder| Utils")
+	TArray<FLBRAudioChannelLevel> GetAudioLevels(int32 Track = 0) const;
+
 	UFUNCTION(BlueprintPure, BlueprintCallable, Category = "LBRuntimeVideoRecorder| Utils")
 	FString GetDateString(FString Format = "%Y.%m.%d-%H.%M.%S");
 
@@ -78,29 +177,60 @@ private:
 	int32 CurrentHeight = 1080;
 
 	bool bIsRecording = false;
+	bool bIsArmed = false;
 	float TimeAccumulator = 0.f;
 	float FrameInterval = 1.f / 30.f;
-	int64 FrameCounter = 0;
+	int64 FrameCounter = 0;       // 下一帧的 PTS（帧间隔数）
+	int64 CaptureSequence = 0;    // 实际发起的捕获数
+	int64 CoalescedFrames = 0;    // 卡顿时合并掉的帧间隔数
 	FString CurrentVideoFilePath;
 
 	// Encode 线程对象（逻辑）
-	FLBRFFmpegEncodeThread* EncodeThread = nullptr;
+	// 后处理线程直接向其推帧，用共享指针保证在途任务结束前不被析构
+	TSharedPtr<FLBRFFmpegEncodeThread, ESPMode::ThreadSafe> EncodeThread;
 
-	// UE 线程包装
+	// UE 线程包装，使用共享编码线程池时为空
 	FRunnableThread* EncodeRunnable = nullptr;
+	TWeakObjectPtr<ULBREncodeSchedulerSubsystem> EncodeSchedulerSubsystem;
+
+	// 每条源轨录制的 submix，创建编码会话时按当时的音频设置确定，预热后改设置不影响本次录制
+	UPROPERTY(Transient)
+	TArray<USoundSubmix*> SessionSubmixes;
 
 	// 音频捕获
-	TSharedPtr<LBSubmixCapture> AudioCapture;
+	TArray<TSharedPtr<LBSubmixCapture>> AudioCaptures;   // 每条源轨一个，与订阅同一 submix 的其他录制器共用
+
+	// 回读像素缓冲池（渲染线程取、编码线程还）
+	TSharedPtr<FLBRFramePool, ESPMode::ThreadSafe> FramePool;
+
+	// 当前 Gamma/Exposure 对应的查找表，参数变化时重建
+	FLBRToneLUTPtr ToneLUT;
+
+	// 回读后处理线程池
+	TSharedPtr<FLBRProcessingPool, ESPMode::ThreadSafe> ProcessingPool;
+
+	// 渲染线程使用的回读环
+	TSharedPtr<FLBRReadbackRing, ESPMode::ThreadSafe> ReadbackRing;
 private:
 	// 获取指定分辨率对应的宽高
 	FIntPoint GetResolutionFromEnum(ELBRVideoResolution Resolution) const;
 
 	void InitRenderTarget();
-	void CaptureFrameAsync();
+	FLBRToneLUTPtr GetToneLUT();
+	void EnsureProcessingPool();
+	void ReleaseProcessingPool();
+	void CreateEncodeSession(const FString& OutputFile);
+	void ShutdownEncodeSession();
+	int32 GetFramePoolCapacity() const;
+	void EnsureFramePool();
+	void EnsureReadbackRing();
+	void ReleaseReadbackRing();
+	void HarvestReadbacks();
+	void CaptureFrameAsync(int32 RepeatCount);
 	void CaptureAsync(
 		UTextureRenderTarget2D* RenderTarget,
-		float InGamma,
-		float InExposure,
-		TFunction<void(const TArray<FColor>&, int32, int32)> Callback);
+		FLBRToneLUTPtr InToneLUT,
+		TFunction<void(FLBRPixelBufferRef, int32, int32)> OnProcessed,
+		TFunction<void()> OnDropped = nullptr);
 	void ExecuteSceneShot(const FString& FileName);
 };
\ No newline at end of file
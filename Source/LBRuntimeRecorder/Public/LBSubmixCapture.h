@@ -4,38 +4,70 @@
 
 #include "CoreMinimal.h"
 #include "ISubmixBufferListener.h"
-#include "LBRTypes.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Templates/Atomic.h"
+#include "LBRAudioRing.h"
 /**
  * 
  */
 
 DECLARE_LOG_CATEGORY_EXTERN(LogLBSubmixCapture, Log, All);
-DECLARE_DELEGATE_OneParam(FLBRAudioFrameDelegate, FLBRAudioFrame&&);
 
+class USoundSubmix;
+
+// 同一音频设备上的同一个 submix 只注册一个监听器，音频线程每块回调一次，依次写入所有订阅会话的环
 class LBSubmixCapture : public ISubmixBufferListener
 {
 public:
-	LBSubmixCapture() {};
+	// 同时订阅同一 submix 的录制会话上限
+	static constexpr int32 MaxSubscribers = 16;
+
+	LBSubmixCapture(uint32 InDeviceId, USoundSubmix* InSubmix);
 	virtual ~LBSubmixCapture() = default;
 
-	bool Initialize();
-	bool Uninitialize();
+	// 游戏线程：让 Ring 开始接收当前音频设备上 Submix（为空时为主 submix）的音频，返回共享的监听器
+	static TSharedPtr<LBSubmixCapture> Subscribe(const FLBRAudioRingPtr& Ring, USoundSubmix* InSubmix = nullptr);
+
+	// 游戏线程：返回后音频线程不会再写入 Ring；最后一个订阅者离开时注销监听器
+	static void Unsubscribe(const TSharedPtr<LBSubmixCapture>& Capture, const FLBRAudioRingPtr& Ring);
 
 	// ISubmixBufferListener
 	void OnNewSubmixBuffer(const USoundSubmix* OwningSubmix, float* AudioData, int32 NumSamples, int32 NumChannels, const int32 SampleRate, double AudioClock) override;
 	const FString& GetListenerName() const override;
 	// ~ ISubmixBufferListener
 
-	FLBRAudioFrameDelegate OnAudioFrame;
+	// 回调收到的每声道样本数（音频线程写，任意线程读）
+	int64 GetCapturedFrames() const { return CapturedFrames.GetValue(); }
+
+	int32 GetNumSubscribers() const;
 
 private:
-	int32 GetSamplesPerDurationSecs(float InSeconds) const;
+	bool Initialize();
+	bool Uninitialize();
+
+	bool AddRing(const FLBRAudioRingPtr& Ring);
+	// 返回剩余订阅数
+	int32 RemoveRing(const FLBRAudioRingPtr& Ring);
+	// 需持有 CriticalSection；释放回调已结束的延迟环
+	void ReleaseDeferredRings();
 
 private:
-	TArray<float> RecordingBuffer;
-	FCriticalSection CriticalSection;
-	bool bInitialized = false;
-	int32 CurrentSampleRate = 0;
-	int32 CurrentNumChannels = 0;
-	int64 AudioSampleCursor = 0;
+	const uint32 DeviceId;
+	const TWeakObjectPtr<USoundSubmix> Submix;
+	const bool bMainSubmix;
+
+	// 音频线程只读 RingSlots 中的裸指针；环的引用由 RingOwners 持有，只在 CriticalSection 下修改
+	TAtomic<FLBRAudioRing*> RingSlots[MaxSubscribers];
+	FLBRAudioRingPtr RingOwners[MaxSubscribers];
+	int32 NumSubscribers = 0;
+
+	// 每次回调前后各加一，奇数表示回调进行中；退订时据此等待在途的回调写完
+	FThreadSafeCounter64 CallbackSerial;
+
+	// 退订时等超时、回调仍在写的环，记下当时的回调序号，序号变化后才释放；剩下的随监听器析构
+	TArray<TPair<int64, FLBRAudioRingPtr>> DeferredReleases;
+
+	mutable FCriticalSection CriticalSection;   // 保护注册 / 注销和订阅表
+	FThreadSafeBool bInitialized = false;
+	FThreadSafeCounter64 CapturedFrames;
 };